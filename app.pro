@@ -0,0 +1,55 @@
+TARGET = toeterm
+CONFIG += sailfishapp link_pkgconfig
+PKGCONFIG += sailfishapp nemonotifications-qt5
+LIBS += -lutil
+
+QT += feedback
+
+include(core/core.pri)
+
+HEADERS += \
+    src/textrender.h \
+    src/util.h \
+    src/keyloader.h \
+    src/glyphcache.h \
+    src/fontfallback.h
+
+SOURCES += \
+    src/main.cpp \
+    src/textrender.cpp \
+    src/util.cpp \
+    src/keyloader.cpp \
+    src/glyphcache.cpp \
+    src/fontfallback.cpp
+
+OTHER_FILES += qml/*
+
+RESOURCES += \
+    resources.qrc
+
+target.path = /usr/bin
+INSTALLS += target
+
+SAILFISHAPP_ICONS = 86x86 108x108 128x128 172x172
+
+CONFIG += sailfishapp_i18n
+
+TRANSLATIONS += translations/toeterm-ru.ts \
+    translations/toeterm-nl.ts \
+    translations/toeterm-sv.ts \
+    translations/toeterm-nl_BE.ts \
+    translations/toeterm-es.ts \
+    translations/toeterm-fi_FI.ts \
+    translations/toeterm-zh_CN.ts
+
+DISTFILES += \
+    tools/gen_charwidth.py \
+    translations/toeterm-nl.ts \
+    translations/toeterm-ru.ts \
+    rpm/toeterm.yaml \
+    rpm/toeterm.spec \
+    translations/toeterm-sv.ts \
+    translations/toeterm-nl_BE.ts \
+    translations/toeterm-es.ts \
+    translations/toeterm-fi_FI.ts \
+    translations/toeterm-zh_CN.ts
@@ -0,0 +1,8 @@
+# Links a project against the emulator core, see core.pro
+
+INCLUDEPATH += $$top_srcdir/src
+DEPENDPATH += $$top_srcdir/src
+LIBS += -L$$top_builddir/core -ltoetermcore
+PRE_TARGETDEPS += $$top_builddir/core/libtoetermcore.a
+
+trace: DEFINES += TOETERM_TRACE
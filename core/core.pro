@@ -0,0 +1,30 @@
+# The emulator core as a static library. It needs nothing beyond QtCore, the
+# application plugs in the clipboard, bell and settings through the
+# interfaces in terminalinterfaces.h.
+
+TEMPLATE = lib
+TARGET = toetermcore
+CONFIG += staticlib c++11
+QT = core
+
+INCLUDEPATH += ../src
+
+# trace points, see trace.h
+trace: DEFINES += TOETERM_TRACE
+
+HEADERS += \
+    ../src/terminal.h \
+    ../src/terminalinterfaces.h \
+    ../src/ptyiface.h \
+    ../src/charwidth.h \
+    ../src/charwidthtable.h \
+    ../src/replay.h \
+    ../src/latency.h \
+    ../src/trace.h
+
+SOURCES += \
+    ../src/terminal.cpp \
+    ../src/ptyiface.cpp \
+    ../src/replay.cpp \
+    ../src/latency.cpp \
+    ../src/trace.cpp
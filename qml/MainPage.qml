@@ -45,6 +45,8 @@ Page {
             allowedOrientations = (parseInt(util.settingsValue("ui/allowedOrientations")) & Orientation.All)
             lineView.anchorToTop = util.settingsValueBool("ui/dockLineviewToTop")
             fadeTimer.interval = util.settingsValue("ui/keyboardFadeOutDelay")
+            latencyOverlay.visible = util.settingsValueBool("ui/showLatency")
+            term.setLatencyTracking(latencyOverlay.visible)
         }
     }
 
@@ -128,6 +130,26 @@ Page {
             z: 5
         }
 
+        Text {
+            // key press to frame latency, enabled with ui/showLatency
+            id: latencyOverlay
+            anchors.top: parent.top
+            anchors.right: parent.right
+            anchors.margins: window.paddingSmall
+            visible: false
+            color: "yellow"
+            font.family: "monospace"
+            font.pixelSize: window.fontSizeSmall
+            z: 5
+
+            Timer {
+                running: latencyOverlay.visible
+                repeat: true
+                interval: 1000
+                onTriggered: latencyOverlay.text = term.latencyReport()
+            }
+        }
+
         Rectangle {
             // bell
             id: bellBg
@@ -151,7 +173,11 @@ Page {
             myHeight: height
             opacity: 1.0
             property int duration: 0;
-            property int cutAfter: height
+            cutAfter: height
+
+            // a pinch only scales the last frame, the font is changed once
+            // the gesture ends
+            transformOrigin: Item.TopLeft
 
             Behavior on opacity {
                 NumberAnimation { duration: textrender.duration; easing.type: Easing.InOutQuad }
@@ -165,12 +191,6 @@ Page {
                 lineView.fontPointSize = textrender.fontPointSize;
             }
 
-            onCutAfterChanged: {
-                // this property is used in the paint function, so make sure that the element gets
-                // painted with the updated value (might not otherwise happen because of caching)
-                textrender.redraw();
-            }
-
             z: 10
         }
 
@@ -295,7 +315,8 @@ Page {
         function displayBufferChanged()
         {
             lineView.lines = term.printableLinesFromCursor(util.settingsValue("ui/showExtraLinesFromCursor"), false);
-            appWindow.lines = term.printableLinesFromCursor(30, true);
+            if(term.isBackground())  // only shown on the cover
+                appWindow.lines = term.printableLinesFromCursor(30, true);
             lineView.cursorX = textrender.cursorPixelPos().x;
             lineView.cursorWidth = textrender.cursorPixelSize().width;
             lineView.cursorHeight = textrender.cursorPixelSize().height;
@@ -447,9 +468,40 @@ Page {
         property var pressedKeys: ({})
         property real spaceXswipe;
         property bool spacePressed: false;
+
+        // touch points on the terminal, two of them make a pinch
+        property var terminalPoints: ({})
+        property int terminalPointCount: 0
+        property real pinchStartDistance: 0
+        property bool pinching: false
+        property bool pinched: false
+
+        function pinchDistance() {
+            var p = [];
+            for (var id in terminalPoints)
+                p.push(terminalPoints[id]);
+            return Math.sqrt(Math.pow(p[0].x - p[1].x, 2) + Math.pow(p[0].y - p[1].y, 2));
+        }
+
+        function endPinch() {
+            var size = textrender.pinchFontPointSize(textrender.scale);
+            textrender.scale = 1.0;
+            pinching = false;
+            textrender.fontPointSize = size;
+        }
+
         onPressed: {
             touchPoints.forEach(function (touchPoint) {
                 var t_y = touchPoint.y + y;
+                if (t_y < vkb.y) {
+                    terminalPoints[touchPoint.pointId] = { x: touchPoint.x, y: t_y };
+                    terminalPointCount++;
+                    if (terminalPointCount == 2 && !pinching) {
+                        pinchStartDistance = Math.max(1, pinchDistance());
+                        pinching = true;
+                        pinched = true;
+                    }
+                }
                 if (multiTouchArea.firstTouchId == -1) {
                     multiTouchArea.firstTouchId = touchPoint.pointId;
 
@@ -471,11 +523,18 @@ Page {
         onUpdated: {
             touchPoints.forEach(function (touchPoint) {
                 var t_y = touchPoint.y + y;
-                if (multiTouchArea.firstTouchId === touchPoint.pointId) {
+                if (terminalPoints[touchPoint.pointId] !== undefined) {
+                    terminalPoints[touchPoint.pointId] = { x: touchPoint.x, y: t_y };
+                }
+                if (multiTouchArea.firstTouchId === touchPoint.pointId && !pinched) {
                     //gestures c++ handler
                     util.mouseMove(touchPoint.x, t_y);
                 }
 
+                if (pinching && terminalPointCount == 2) {
+                    textrender.scale = pinchDistance() / pinchStartDistance;
+                }
+
                 var key = multiTouchArea.pressedKeys[touchPoint.pointId];
                 if (key !== null) {
                     if (!key.handleMove(multiTouchArea, touchPoint.x, t_y)) {
@@ -507,6 +566,16 @@ Page {
             touchPoints.forEach(function (touchPoint) {
                 var t_y = touchPoint.y + y;
                 var t_y2 = touchPoint.startY + y;
+                if (terminalPoints[touchPoint.pointId] !== undefined) {
+                    delete terminalPoints[touchPoint.pointId];
+                    terminalPointCount--;
+                    if (pinching)
+                        endPinch();
+                }
+                if (multiTouchArea.firstTouchId === touchPoint.pointId && pinched) {
+                    // the fingers of a pinch are neither taps nor drags
+                    multiTouchArea.firstTouchId = -1;
+                }
                 if (multiTouchArea.firstTouchId === touchPoint.pointId) {
                     // Toggle keyboard wake-up when tapping outside the keyboard, but:
                     //   - only when not scrolling (y-diff < 20 pixels)
@@ -541,6 +610,8 @@ Page {
                     } else key.handleRelease(multiTouchArea, touchPoint.x, t_y);
                 }
                 delete multiTouchArea.pressedKeys[touchPoint.pointId];
+                if (terminalPointCount == 0)
+                    pinched = false;
             });
         }
     }
@@ -405,6 +405,24 @@ Page {
                         text: qsTr("Keyboard feedback")
                         onCheckedChanged: util.setSettingsValue("ui/keyPressFeedback", checked)
                     }
+                    TextSwitch {
+                        enabled: section4.expanded
+                        checked: util.settingsValueBool("terminal/allowClipboardWrite")
+                        width: parent.width
+                        text: qsTr("Programs can set the clipboard")
+                        description: qsTr("Lets the output of any program, also over ssh, replace the clipboard (OSC 52)")
+                        onCheckedChanged: util.setSettingsValue("terminal/allowClipboardWrite", checked)
+                    }
+                    TextSwitch {
+                        enabled: section4.expanded
+                        checked: util.settingsValueBool("ui/showPerformanceHud")
+                        width: parent.width
+                        text: qsTr("Performance overlay")
+                        onCheckedChanged: {
+                            util.setSettingsValue("ui/showPerformanceHud", checked)
+                            pageStack.previousPage().textRenderItem.showPerformanceHud = checked
+                        }
+                    }
                     ComboBox {
                         id: charsetFieldCombo
                         width: parent.width
@@ -0,0 +1,45 @@
+/*
+    ThumbTerm Copyright Olli Vanhoja
+    FingerTerm Copyright 2011-2012 Heikki Holstila <heikki.holstila@gmail.com>
+    ToeTerm Copyright 2018 ROZZ, 2019 Matti Viljanen
+
+    This file is part of ToeTerm.
+
+    ToeTerm is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    ToeTerm is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ToeTerm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CHARWIDTH_H
+#define CHARWIDTH_H
+
+#include <QtGlobal>
+
+#include "charwidthtable.h"
+
+// Number of terminal cells a codepoint takes: 0 for combining marks and
+// other zero width characters, 2 for East Asian wide and fullwidth ones,
+// 1 for everything else. Two table lookups, the tables are generated by
+// tools/gen_charwidth.py.
+inline int charWidth(uint code)
+{
+    if (code < 0x7F)
+        return code >= 0x20 ? 1 : 0;
+    if (code >= 0x110000)
+        return 1;
+
+    const quint8 block = charWidthStage1[code >> 8];
+    return (charWidthStage2[block][(code & 0xFF) >> 2] >> ((code & 3) * 2)) & 3;
+}
+
+#endif // CHARWIDTH_H
@@ -0,0 +1,201 @@
+/*
+    ThumbTerm Copyright Olli Vanhoja
+    FingerTerm Copyright 2011-2012 Heikki Holstila <heikki.holstila@gmail.com>
+    ToeTerm Copyright 2018 ROZZ, 2019 Matti Viljanen
+
+    This file is part of ToeTerm.
+
+    ToeTerm is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    ToeTerm is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ToeTerm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QDebug>
+
+#include "fontfallback.h"
+
+// looked at, in this order, for characters neither the terminal font nor
+// the font of their script has
+static const char* const lastResortFamilies[] = {
+    "Noto Color Emoji",
+    "Noto Emoji",
+    "Noto Sans Symbols",
+    "Noto Sans Symbols2",
+    "Symbola",
+    "DejaVu Sans",
+    0
+};
+
+FontFallback::FontFallback()
+{
+}
+
+void FontFallback::setFont(const QFont& font)
+{
+    bool sameFamily = (font.family() == iPrimary.family());
+
+    iPrimary = font;
+    iPrimaryBold = font;
+    iPrimaryBold.setBold(true);
+
+    if (!sameFamily || iFamilies.isEmpty()) {
+        // everything resolved so far is relative to the old family
+        iFamilies.clear();
+        iResolved.clear();
+        iFamilies.append(font.family());
+        loadLastResortFonts();
+    }
+
+    // the resolved families stay valid across size changes, only the
+    // font objects are recreated
+    iFonts.clear();
+    iBoldFonts.clear();
+    iRawFonts.clear();
+    iFonts.append(iPrimary);
+    iBoldFonts.append(iPrimaryBold);
+    iRawFonts.append(QRawFont::fromFont(iPrimary));
+    for (int i=1; i<iFamilies.size(); i++) {
+        iFonts.append(fallbackFont(iFamilies.at(i), false));
+        iBoldFonts.append(fallbackFont(iFamilies.at(i), true));
+        iRawFonts.append(QRawFont::fromFont(iFonts.last()));
+    }
+}
+
+int FontFallback::fontIndex(uint code)
+{
+    // the terminal font is expected to cover ascii
+    if (code < 0x80)
+        return 0;
+
+    QHash<uint, int>::const_iterator i = iResolved.constFind(code);
+    if (i != iResolved.constEnd())
+        return i.value();
+
+    int index = resolve(code);
+    iResolved.insert(code, index);
+    return index;
+}
+
+const QFont& FontFallback::font(int index, bool bold)
+{
+    if (index < 0 || index >= iFonts.size())
+        index = 0;
+
+    return bold ? iBoldFonts.at(index) : iFonts.at(index);
+}
+
+int FontFallback::resolve(uint code)
+{
+    if (QChar::isSurrogate(code))
+        return 0;
+
+    for (int i=0; i<iRawFonts.size(); i++) {
+        if (iRawFonts.at(i).supportsCharacter(code))
+            return i;
+    }
+
+    // the font Qt would merge in for the script of the character
+    QFontDatabase::WritingSystem ws = writingSystem(code);
+    if (ws != QFontDatabase::Any) {
+        QRawFont raw = QRawFont::fromFont(iPrimary, ws);
+        if (raw.isValid() && raw.supportsCharacter(code))
+            return addFamily(raw.familyName());
+    }
+
+    // last resort (symbols, emoji...)
+    foreach (const QRawFont& raw, iLastResortFonts) {
+        if (raw.supportsCharacter(code))
+            return addFamily(raw.familyName());
+    }
+
+    // nothing has it, leave it to Qt
+    return 0;
+}
+
+int FontFallback::addFamily(const QString& family)
+{
+    int index = iFamilies.indexOf(family);
+    if (index >= 0)
+        return index;
+
+    iFamilies.append(family);
+    iFonts.append(fallbackFont(family, false));
+    iBoldFonts.append(fallbackFont(family, true));
+    iRawFonts.append(QRawFont::fromFont(iFonts.last()));
+
+    return iFamilies.size()-1;
+}
+
+void FontFallback::loadLastResortFonts()
+{
+    // only a short list: opening every installed family would stall the
+    // frame that first needs one
+    QFontDatabase db;
+    const QStringList installed = db.families();
+    iLastResortFonts.clear();
+    for (int i=0; lastResortFamilies[i]; i++) {
+        const QString family(lastResortFamilies[i]);
+        if (!installed.contains(family, Qt::CaseInsensitive))
+            continue;
+        QRawFont raw = QRawFont::fromFont(QFont(family, iPrimary.pointSize()));
+        if (raw.isValid())
+            iLastResortFonts.append(raw);
+    }
+}
+
+QFont FontFallback::fallbackFont(const QString& family, bool bold)
+{
+    // the family has already been picked, so Qt should not merge again
+    QFont font(family, iPrimary.pointSize());
+    font.setBold(bold);
+    font.setKerning(false);
+    font.setStyleStrategy(QFont::StyleStrategy(QFont::ForceIntegerMetrics | QFont::NoFontMerging));
+    return font;
+}
+
+QFontDatabase::WritingSystem FontFallback::writingSystem(uint code)
+{
+    switch (QChar::script(code)) {
+    case QChar::Script_Latin: return QFontDatabase::Latin;
+    case QChar::Script_Greek: return QFontDatabase::Greek;
+    case QChar::Script_Cyrillic: return QFontDatabase::Cyrillic;
+    case QChar::Script_Armenian: return QFontDatabase::Armenian;
+    case QChar::Script_Hebrew: return QFontDatabase::Hebrew;
+    case QChar::Script_Arabic: return QFontDatabase::Arabic;
+    case QChar::Script_Syriac: return QFontDatabase::Syriac;
+    case QChar::Script_Thaana: return QFontDatabase::Thaana;
+    case QChar::Script_Devanagari: return QFontDatabase::Devanagari;
+    case QChar::Script_Bengali: return QFontDatabase::Bengali;
+    case QChar::Script_Gurmukhi: return QFontDatabase::Gurmukhi;
+    case QChar::Script_Gujarati: return QFontDatabase::Gujarati;
+    case QChar::Script_Oriya: return QFontDatabase::Oriya;
+    case QChar::Script_Tamil: return QFontDatabase::Tamil;
+    case QChar::Script_Telugu: return QFontDatabase::Telugu;
+    case QChar::Script_Kannada: return QFontDatabase::Kannada;
+    case QChar::Script_Malayalam: return QFontDatabase::Malayalam;
+    case QChar::Script_Sinhala: return QFontDatabase::Sinhala;
+    case QChar::Script_Thai: return QFontDatabase::Thai;
+    case QChar::Script_Lao: return QFontDatabase::Lao;
+    case QChar::Script_Tibetan: return QFontDatabase::Tibetan;
+    case QChar::Script_Myanmar: return QFontDatabase::Myanmar;
+    case QChar::Script_Georgian: return QFontDatabase::Georgian;
+    case QChar::Script_Khmer: return QFontDatabase::Khmer;
+    case QChar::Script_Han: return QFontDatabase::SimplifiedChinese;
+    case QChar::Script_Hiragana:
+    case QChar::Script_Katakana: return QFontDatabase::Japanese;
+    case QChar::Script_Hangul: return QFontDatabase::Korean;
+    case QChar::Script_Ogham: return QFontDatabase::Ogham;
+    case QChar::Script_Runic: return QFontDatabase::Runic;
+    case QChar::Script_Nko: return QFontDatabase::Nko;
+    default: return QFontDatabase::Any;
+    }
+}
@@ -0,0 +1,71 @@
+/*
+    ThumbTerm Copyright Olli Vanhoja
+    FingerTerm Copyright 2011-2012 Heikki Holstila <heikki.holstila@gmail.com>
+    ToeTerm Copyright 2018 ROZZ, 2019 Matti Viljanen
+
+    This file is part of ToeTerm.
+
+    ToeTerm is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    ToeTerm is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ToeTerm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FONTFALLBACK_H
+#define FONTFALLBACK_H
+
+#include <QFont>
+#include <QRawFont>
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include <QFontDatabase>
+
+// Resolves which font draws a character that is missing from the
+// configured terminal font. The result is remembered per codepoint, so
+// Qt's font merging search is done once per character instead of on every
+// drawText() call. Index 0 is the terminal font itself.
+class FontFallback
+{
+public:
+    FontFallback();
+
+    void setFont(const QFont& font);
+    int fontIndex(uint code);
+    const QFont& font(int index, bool bold);
+    int count() { return iFonts.size(); }
+
+private:
+    Q_DISABLE_COPY(FontFallback)
+
+    int resolve(uint code);
+    int addFamily(const QString& family);
+    QFont fallbackFont(const QString& family, bool bold);
+    void loadLastResortFonts();
+    static QFontDatabase::WritingSystem writingSystem(uint code);
+
+    QFont iPrimary;
+    QFont iPrimaryBold;
+
+    // fonts 1..n, index 0 of these lists is the terminal font
+    QStringList iFamilies;
+    QList<QFont> iFonts;
+    QList<QFont> iBoldFonts;
+    QList<QRawFont> iRawFonts;
+
+    // the installed ones of the last resort (symbol and emoji) families,
+    // loaded with the font instead of on the first miss while painting
+    QList<QRawFont> iLastResortFonts;
+
+    QHash<uint, int> iResolved;
+};
+
+#endif // FONTFALLBACK_H
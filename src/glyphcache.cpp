@@ -0,0 +1,330 @@
+/*
+    ThumbTerm Copyright Olli Vanhoja
+    FingerTerm Copyright 2011-2012 Heikki Holstila <heikki.holstila@gmail.com>
+    ToeTerm Copyright 2018 ROZZ, 2019 Matti Viljanen
+
+    This file is part of ToeTerm.
+
+    ToeTerm is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    ToeTerm is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ToeTerm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "glyphcache.h"
+
+// Box drawing line weights for U+2500-U+257F. Two bits per direction,
+// up << 6 | right << 4 | down << 2 | left, see GlyphCache::LineWeight.
+// The dashed variants carry the weights of the matching solid line, the
+// arcs and diagonals (U+256D-U+2573) are drawn separately.
+static const quint8 boxLines[128] = {
+    0x11, 0x22, 0x44, 0x88, 0x11, 0x22, 0x44, 0x88,  // U+2500
+    0x11, 0x22, 0x44, 0x88, 0x14, 0x24, 0x18, 0x28,  // U+2508
+    0x05, 0x06, 0x09, 0x0a, 0x50, 0x60, 0x90, 0xa0,  // U+2510
+    0x41, 0x42, 0x81, 0x82, 0x54, 0x64, 0x94, 0x58,  // U+2518
+    0x98, 0xa4, 0x68, 0xa8, 0x45, 0x46, 0x85, 0x49,  // U+2520
+    0x89, 0x86, 0x4a, 0x8a, 0x15, 0x16, 0x25, 0x26,  // U+2528
+    0x19, 0x1a, 0x29, 0x2a, 0x51, 0x52, 0x61, 0x62,  // U+2530
+    0x91, 0x92, 0xa1, 0xa2, 0x55, 0x56, 0x65, 0x66,  // U+2538
+    0x95, 0x59, 0x99, 0x96, 0xa5, 0x5a, 0x69, 0xa6,  // U+2540
+    0x6a, 0x9a, 0xa9, 0xaa, 0x11, 0x22, 0x44, 0x88,  // U+2548
+    0x33, 0xcc, 0x34, 0x1c, 0x3c, 0x07, 0x0d, 0x0f,  // U+2550
+    0x70, 0xd0, 0xf0, 0x43, 0xc1, 0xc3, 0x74, 0xdc,  // U+2558
+    0xfc, 0x47, 0xcd, 0xcf, 0x37, 0x1d, 0x3f, 0x73,  // U+2560
+    0xd1, 0xf3, 0x77, 0xdd, 0xff, 0x00, 0x00, 0x00,  // U+2568
+    0x00, 0x00, 0x00, 0x00, 0x01, 0x40, 0x10, 0x04,  // U+2570
+    0x02, 0x80, 0x20, 0x08, 0x21, 0x48, 0x12, 0x84,  // U+2578
+};
+
+// Quadrants lit by U+2596-U+259F: 1 upper left, 2 upper right,
+// 4 lower left, 8 lower right
+static const quint8 blockQuadrants[10] = {
+    4, 8, 1, 13, 9, 7, 11, 2, 6, 14
+};
+
+struct Band {
+    int start;
+    int end;
+};
+
+static Band band(int center, int size)
+{
+    Band b;
+    b.start = center - size/2;
+    b.end = b.start + size;
+    return b;
+}
+
+GlyphCache::GlyphCache() :
+    iCellWidth(0),
+    iCellHeight(0),
+    iLineWidth(1),
+    iMisses(0)
+{
+    iGlyphs.setMaxCost(maxGlyphs);
+}
+
+void GlyphCache::setCellSize(int width, int height)
+{
+    if (iCellWidth == width && iCellHeight == height)
+        return;
+
+    iCellWidth = width;
+    iCellHeight = height;
+    iLineWidth = qMax(1, qRound(width / 8.0));
+    iGlyphs.clear();
+}
+
+const QImage& GlyphCache::glyph(uint code, QRgb color)
+{
+    static const QImage nullImage;
+
+    if (iCellWidth <= 0 || iCellHeight <= 0)
+        return nullImage;
+
+    const quint64 key = (quint64(color) << 32) | code;
+    if (const QImage* cached = iGlyphs.object(key))
+        return *cached;
+
+    // a miss allocates an image; the least recently used glyphs go once
+    // the cache is full
+    iMisses++;
+    QImage* image = new QImage(iCellWidth, iCellHeight, QImage::Format_ARGB32_Premultiplied);
+    image->fill(Qt::transparent);
+    QPainter painter(image);
+    drawGlyph(&painter, code, QColor::fromRgb(color));
+    painter.end();
+
+    iGlyphs.insert(key, image);
+    return *image;
+}
+
+int GlyphCache::thickness(int weight)
+{
+    switch (weight) {
+    case LineLight:
+        return iLineWidth;
+    case LineHeavy:
+        return 2*iLineWidth;
+    case LineDouble:
+        return 3*iLineWidth;
+    default:
+        return 0;
+    }
+}
+
+void GlyphCache::drawGlyph(QPainter* painter, uint code, const QColor& color)
+{
+    if ((code >= 0x2504 && code <= 0x250B) || (code >= 0x254C && code <= 0x254F)) {
+        int count = code >= 0x254C ? 2 : (code >= 0x2508 ? 4 : 3);
+        drawDashes(painter, code & 2, count, thickness(code & 1 ? LineHeavy : LineLight), color);
+    }
+    else if (code >= 0x256D && code <= 0x2570) {
+        drawArc(painter, code, color);
+    }
+    else if (code >= 0x2571 && code <= 0x2573) {
+        drawDiagonals(painter, code, color);
+    }
+    else if (code >= 0x2500 && code <= 0x257F) {
+        drawLines(painter, code, color);
+    }
+    else if (code >= 0x2580 && code <= 0x259F) {
+        drawBlock(painter, code, color);
+    }
+    else if (code >= 0x23BA && code <= 0x23BD) {
+        // DEC scan lines 1, 3, 7 and 9 of a nine line cell
+        static const int scanLines[4] = { 1, 3, 7, 9 };
+        int y = qRound((scanLines[code-0x23BA]-1) * (iCellHeight-iLineWidth) / 8.0);
+        painter->fillRect(0, y, iCellWidth, iLineWidth, color);
+    }
+    else if (code == 0x25C6) {
+        qreal cx = iCellWidth / 2.0;
+        qreal cy = iCellHeight / 2.0;
+        qreal r = qMax(1.0, qMin(iCellWidth, iCellHeight) / 2.0 - 1);
+        QPointF points[4] = {
+            QPointF(cx, cy-r), QPointF(cx+r, cy), QPointF(cx, cy+r), QPointF(cx-r, cy)
+        };
+        painter->setRenderHint(QPainter::Antialiasing);
+        painter->setPen(Qt::NoPen);
+        painter->setBrush(color);
+        painter->drawPolygon(points, 4);
+    }
+}
+
+void GlyphCache::drawLines(QPainter* painter, uint code, const QColor& color)
+{
+    const int arms = boxLines[code-0x2500];
+    const int up = (arms >> 6) & 3;
+    const int right = (arms >> 4) & 3;
+    const int down = (arms >> 2) & 3;
+    const int left = arms & 3;
+    const int cx = iCellWidth / 2;
+    const int cy = iCellHeight / 2;
+    const Band gapX = band(cx, thickness(LineLight));
+    const Band gapY = band(cy, thickness(LineLight));
+
+    // Where the arms of each axis meet the other axis. Arms are extended
+    // over the perpendicular line so that corners and joins are closed,
+    // except when a single or heavy line meets a double line passing
+    // through, then it stops at the near stroke of the double line.
+    Band joinX = band(cx, thickness(qMax(qMax(up, down), qMax(left, right))));
+    if (up || down)
+        joinX = band(cx, thickness(qMax(up, down)));
+    Band joinY = band(cy, thickness(qMax(qMax(up, down), qMax(left, right))));
+    if (left || right)
+        joinY = band(cy, thickness(qMax(left, right)));
+
+    // double lines: one wide band, the gap is cleared afterwards
+    const Band doubleX = band(cx, thickness(LineDouble));
+    const Band doubleY = band(cy, thickness(LineDouble));
+    if (left == LineDouble)
+        painter->fillRect(0, doubleY.start, joinX.end, doubleY.end-doubleY.start, color);
+    if (right == LineDouble)
+        painter->fillRect(joinX.start, doubleY.start, iCellWidth-joinX.start, doubleY.end-doubleY.start, color);
+    if (up == LineDouble)
+        painter->fillRect(doubleX.start, 0, doubleX.end-doubleX.start, joinY.end, color);
+    if (down == LineDouble)
+        painter->fillRect(doubleX.start, joinY.start, doubleX.end-doubleX.start, iCellHeight-joinY.start, color);
+
+    painter->setCompositionMode(QPainter::CompositionMode_Clear);
+    if (left == LineDouble)
+        painter->fillRect(0, gapY.start, gapX.end, gapY.end-gapY.start, Qt::transparent);
+    if (right == LineDouble)
+        painter->fillRect(gapX.start, gapY.start, iCellWidth-gapX.start, gapY.end-gapY.start, Qt::transparent);
+    if (up == LineDouble)
+        painter->fillRect(gapX.start, 0, gapX.end-gapX.start, gapY.end, Qt::transparent);
+    if (down == LineDouble)
+        painter->fillRect(gapX.start, gapY.start, gapX.end-gapX.start, iCellHeight-gapY.start, Qt::transparent);
+    painter->setCompositionMode(QPainter::CompositionMode_SourceOver);
+
+    // single and heavy lines
+    Band stopX = joinX;
+    if (up == LineDouble && down == LineDouble) {
+        stopX.start = gapX.end;
+        stopX.end = gapX.start;
+    }
+    Band stopY = joinY;
+    if (left == LineDouble && right == LineDouble) {
+        stopY.start = gapY.end;
+        stopY.end = gapY.start;
+    }
+
+    if (left == LineLight || left == LineHeavy) {
+        Band b = band(cy, thickness(left));
+        painter->fillRect(0, b.start, stopX.end, b.end-b.start, color);
+    }
+    if (right == LineLight || right == LineHeavy) {
+        Band b = band(cy, thickness(right));
+        painter->fillRect(stopX.start, b.start, iCellWidth-stopX.start, b.end-b.start, color);
+    }
+    if (up == LineLight || up == LineHeavy) {
+        Band b = band(cx, thickness(up));
+        painter->fillRect(b.start, 0, b.end-b.start, stopY.end, color);
+    }
+    if (down == LineLight || down == LineHeavy) {
+        Band b = band(cx, thickness(down));
+        painter->fillRect(b.start, stopY.start, b.end-b.start, iCellHeight-stopY.start, color);
+    }
+}
+
+void GlyphCache::drawDashes(QPainter* painter, bool vertical, int count, int thickness, const QColor& color)
+{
+    const int length = vertical ? iCellHeight : iCellWidth;
+    const qreal segment = length / qreal(count);
+    const int gap = qMax(1, qRound(segment / 4));
+    const Band b = vertical ? band(iCellWidth/2, thickness) : band(iCellHeight/2, thickness);
+
+    for (int i=0; i<count; i++) {
+        int start = qRound(i*segment);
+        int end = qRound((i+1)*segment) - gap;
+        if (end <= start)
+            end = start + 1;
+        if (vertical)
+            painter->fillRect(b.start, start, b.end-b.start, end-start, color);
+        else
+            painter->fillRect(start, b.start, end-start, b.end-b.start, color);
+    }
+}
+
+void GlyphCache::drawArc(QPainter* painter, uint code, const QColor& color)
+{
+    const int light = thickness(LineLight);
+    const qreal x0 = band(iCellWidth/2, light).start + light/2.0;
+    const qreal y0 = band(iCellHeight/2, light).start + light/2.0;
+    const qreal r = qMin(iCellWidth, iCellHeight) / 2.0;
+    const int dx = (code == 0x256D || code == 0x2570) ? 1 : -1;  // towards right
+    const int dy = (code == 0x256D || code == 0x256E) ? 1 : -1;  // towards bottom
+
+    QPainterPath path;
+    path.moveTo(x0, dy > 0 ? iCellHeight : 0);
+    path.lineTo(x0, y0 + dy*r);
+    path.quadTo(x0, y0, x0 + dx*r, y0);
+    path.lineTo(dx > 0 ? iCellWidth : 0, y0);
+
+    painter->setRenderHint(QPainter::Antialiasing);
+    painter->setPen(QPen(color, light, Qt::SolidLine, Qt::FlatCap));
+    painter->setBrush(Qt::NoBrush);
+    painter->drawPath(path);
+}
+
+void GlyphCache::drawDiagonals(QPainter* painter, uint code, const QColor& color)
+{
+    painter->setRenderHint(QPainter::Antialiasing);
+    painter->setPen(QPen(color, thickness(LineLight), Qt::SolidLine, Qt::FlatCap));
+    if (code == 0x2571 || code == 0x2573)
+        painter->drawLine(QPointF(iCellWidth, 0), QPointF(0, iCellHeight));
+    if (code == 0x2572 || code == 0x2573)
+        painter->drawLine(QPointF(0, 0), QPointF(iCellWidth, iCellHeight));
+}
+
+void GlyphCache::drawBlock(QPainter* painter, uint code, const QColor& color)
+{
+    const int w = iCellWidth;
+    const int h = iCellHeight;
+
+    if (code == 0x2580) {  // upper half
+        painter->fillRect(0, 0, w, h/2, color);
+    }
+    else if (code >= 0x2581 && code <= 0x2588) {  // lower eighths, full block
+        int height = qRound(h * (code-0x2580) / 8.0);
+        painter->fillRect(0, h-height, w, height, color);
+    }
+    else if (code >= 0x2589 && code <= 0x258F) {  // left eighths
+        int width = qRound(w * (0x2590-code) / 8.0);
+        painter->fillRect(0, 0, width, h, color);
+    }
+    else if (code == 0x2590) {  // right half
+        painter->fillRect(w/2, 0, w-w/2, h, color);
+    }
+    else if (code >= 0x2591 && code <= 0x2593) {  // shades
+        QColor shade(color);
+        shade.setAlpha(64 * (code-0x2590));
+        painter->fillRect(0, 0, w, h, shade);
+    }
+    else if (code == 0x2594) {  // upper eighth
+        painter->fillRect(0, 0, w, qMax(1, qRound(h/8.0)), color);
+    }
+    else if (code == 0x2595) {  // right eighth
+        int width = qMax(1, qRound(w/8.0));
+        painter->fillRect(w-width, 0, width, h, color);
+    }
+    else if (code >= 0x2596 && code <= 0x259F) {  // quadrants
+        int quadrants = blockQuadrants[code-0x2596];
+        if (quadrants & 1)
+            painter->fillRect(0, 0, w/2, h/2, color);
+        if (quadrants & 2)
+            painter->fillRect(w/2, 0, w-w/2, h/2, color);
+        if (quadrants & 4)
+            painter->fillRect(0, h/2, w/2, h-h/2, color);
+        if (quadrants & 8)
+            painter->fillRect(w/2, h/2, w-w/2, h-h/2, color);
+    }
+}
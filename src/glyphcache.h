@@ -0,0 +1,77 @@
+/*
+    ThumbTerm Copyright Olli Vanhoja
+    FingerTerm Copyright 2011-2012 Heikki Holstila <heikki.holstila@gmail.com>
+    ToeTerm Copyright 2018 ROZZ, 2019 Matti Viljanen
+
+    This file is part of ToeTerm.
+
+    ToeTerm is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    ToeTerm is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ToeTerm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GLYPHCACHE_H
+#define GLYPHCACHE_H
+
+#include <QCache>
+#include <QImage>
+#include <QPainter>
+
+// Cell sized glyph images, keyed by character and color.
+//
+// Box drawing (U+2500-U+257F), block elements (U+2580-U+259F) and the
+// remaining DEC special graphics symbols are not taken from the font but
+// drawn procedurally at exactly the cell size, so that lines and blocks
+// connect without gaps between cells. The cache is bounded, the least
+// recently used glyphs are dropped first.
+class GlyphCache
+{
+public:
+    GlyphCache();
+
+    static bool isProcedural(uint code) {
+        return (code >= 0x2500 && code <= 0x259F) ||
+               (code >= 0x23BA && code <= 0x23BD) || // scan lines 1, 3, 7, 9
+                code == 0x25C6;                      // diamond
+    }
+
+    void setCellSize(int width, int height);
+    const QImage& glyph(uint code, QRgb color);
+    void clear() { iGlyphs.clear(); }
+
+    // glyphs that had to be drawn (and allocated), a running total
+    int misses() const { return iMisses; }
+
+private:
+    Q_DISABLE_COPY(GlyphCache)
+
+    enum LineWeight { LineNone = 0, LineLight = 1, LineHeavy = 2, LineDouble = 3 };
+
+    void drawGlyph(QPainter* painter, uint code, const QColor& color);
+    void drawLines(QPainter* painter, uint code, const QColor& color);
+    void drawDashes(QPainter* painter, bool vertical, int count, int thickness, const QColor& color);
+    void drawArc(QPainter* painter, uint code, const QColor& color);
+    void drawDiagonals(QPainter* painter, uint code, const QColor& color);
+    void drawBlock(QPainter* painter, uint code, const QColor& color);
+    int thickness(int weight);
+
+    static const int maxGlyphs = 4096;
+
+    int iCellWidth;
+    int iCellHeight;
+    int iLineWidth;
+    int iMisses;
+
+    QCache<quint64, QImage> iGlyphs;
+};
+
+#endif // GLYPHCACHE_H
@@ -0,0 +1,144 @@
+/*
+    ThumbTerm Copyright Olli Vanhoja
+    FingerTerm Copyright 2011-2012 Heikki Holstila <heikki.holstila@gmail.com>
+    ToeTerm Copyright 2018 ROZZ, 2019 Matti Viljanen
+
+    This file is part of ToeTerm.
+
+    ToeTerm is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    ToeTerm is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ToeTerm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "latency.h"
+
+LatencyHistogram::LatencyHistogram() :
+    iBuckets(bucketCount, 0),
+    iOverflow(0),
+    iCount(0),
+    iSum(0),
+    iMax(0)
+{
+}
+
+void LatencyHistogram::add(qint64 nsecs)
+{
+    const qint64 index = nsecs / bucketWidth;
+    if(index < bucketCount)
+        iBuckets[index]++;
+    else
+        iOverflow++;
+    iCount++;
+    iSum += nsecs;
+    iMax = qMax(iMax, nsecs);
+}
+
+void LatencyHistogram::clear()
+{
+    iBuckets.fill(0);
+    iOverflow = 0;
+    iCount = 0;
+    iSum = 0;
+    iMax = 0;
+}
+
+double LatencyHistogram::percentileMs(double p) const
+{
+    // upper edge of the bucket the percentile falls in
+    const int target = qCeil(p * iCount);
+    int seen = 0;
+    for(int i=0; i<bucketCount; i++) {
+        seen += iBuckets.at(i);
+        if(seen >= target && seen > 0)
+            return qMin((i+1) * bucketWidth, iMax) / 1e6;
+    }
+    return iMax / 1e6;
+}
+
+LatencyStats::LatencyStats() :
+    iEnabled(false)
+{
+    iClock.start();
+}
+
+void LatencyStats::setEnabled(bool enabled)
+{
+    iEnabled = enabled;
+    if(!enabled)
+        iPending.clear();
+}
+
+void LatencyStats::mark(int stage)
+{
+    const qint64 now = iClock.nsecsElapsed();
+
+    if(stage == 0) {
+        while(!iPending.isEmpty() && (iPending.count() >= maxPending ||
+                                      now - iPending.first().times[0] > maxPendingAge))
+            iPending.removeFirst();
+        Pending key;
+        key.times[0] = now;
+        key.times[1] = -1;
+        key.times[2] = -1;
+        iPending.append(key);
+        return;
+    }
+
+    // a write belongs to the oldest key not written yet (a key press writes
+    // at once, other writes find none); a read echoes every written key
+    for(int i=0; i<iPending.count(); i++) {
+        Pending &key = iPending[i];
+        if(key.times[stage-1] >= 0 && key.times[stage] < 0) {
+            key.times[stage] = now;
+            if(stage == 1)
+                break;
+        }
+    }
+}
+
+void LatencyStats::painted()
+{
+    if(!iEnabled)
+        return;
+
+    const qint64 now = iClock.nsecsElapsed();
+    while(!iPending.isEmpty() && iPending.first().times[2] >= 0) {
+        const Pending key = iPending.takeFirst();
+        iHistograms[KeyToWrite].add(key.times[1] - key.times[0]);
+        iHistograms[WriteToEcho].add(key.times[2] - key.times[1]);
+        iHistograms[EchoToPaint].add(now - key.times[2]);
+        iHistograms[KeyToPaint].add(now - key.times[0]);
+    }
+}
+
+void LatencyStats::clear()
+{
+    iPending.clear();
+    for(int i=0; i<StageCount; i++)
+        iHistograms[i].clear();
+}
+
+QString LatencyStats::report() const
+{
+    static const char* const names[StageCount] = { "key-write", "write-echo", "echo-paint", "key-paint" };
+
+    QString text = QString("latency, %1 keys (ms: p50 p90 p99 max)").arg(iHistograms[KeyToPaint].count());
+    for(int i=0; i<StageCount; i++) {
+        const LatencyHistogram &h = iHistograms[i];
+        text += QString("\n%1 %2 %3 %4 %5").arg(names[i], -11)
+                .arg(h.percentileMs(0.5), 0, 'f', 1)
+                .arg(h.percentileMs(0.9), 0, 'f', 1)
+                .arg(h.percentileMs(0.99), 0, 'f', 1)
+                .arg(h.max() / 1e6, 0, 'f', 1);
+    }
+    return text;
+}
@@ -0,0 +1,99 @@
+/*
+    ThumbTerm Copyright Olli Vanhoja
+    FingerTerm Copyright 2011-2012 Heikki Holstila <heikki.holstila@gmail.com>
+    ToeTerm Copyright 2018 ROZZ, 2019 Matti Viljanen
+
+    This file is part of ToeTerm.
+
+    ToeTerm is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    ToeTerm is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ToeTerm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <QtCore>
+
+// Distribution of one latency, in 100 us buckets up to 100 ms; longer ones
+// only count towards the maximum and the top percentiles.
+class LatencyHistogram
+{
+public:
+    static const int bucketCount = 1000;
+    static const qint64 bucketWidth = 100000;  // ns
+
+    LatencyHistogram();
+
+    void add(qint64 nsecs);
+    void clear();
+
+    int count() const { return iCount; }
+    int bucket(int index) const { return iBuckets.at(index); }
+    qint64 max() const { return iMax; }
+    double meanMs() const { return iCount ? iSum / 1e6 / iCount : 0; }
+    double percentileMs(double p) const;
+
+private:
+    QVector<int> iBuckets;
+    int iOverflow;
+    int iCount;
+    qint64 iSum;
+    qint64 iMax;
+};
+
+// Time from a key press to the frame showing its echo, by stage. Terminal
+// marks the key press, PtyIFace the write and the read of the echo, and
+// TextRender the painted frame. Every read while keys are waiting for their
+// echo counts as the echo, so the numbers are exact with a plain echo (or
+// toeterm-latency) and approximate while other output is coming.
+//
+// Off by default; when off, the marks return at once.
+class LatencyStats
+{
+public:
+    enum Stage { KeyToWrite, WriteToEcho, EchoToPaint, KeyToPaint, StageCount };
+
+    LatencyStats();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return iEnabled; }
+
+    void keyPressed() { if(iEnabled) mark(0); }
+    void written() { if(iEnabled) mark(1); }
+    void echoed() { if(iEnabled) mark(2); }
+    void painted();
+
+    const LatencyHistogram& histogram(Stage stage) const { return iHistograms[stage]; }
+    void clear();
+    QString report() const;
+
+private:
+    Q_DISABLE_COPY(LatencyStats)
+
+    static const int maxPending = 32;
+    static const qint64 maxPendingAge = 1000000000LL;  // ns, keys that never echo (passwords)
+
+    // stage times of one key, -1 until reached
+    struct Pending {
+        qint64 times[3];
+    };
+
+    void mark(int stage);
+
+    bool iEnabled;
+    QElapsedTimer iClock;
+    QList<Pending> iPending;
+    LatencyHistogram iHistograms[StageCount];
+};
+
+#endif // LATENCY_H
@@ -41,6 +41,7 @@ extern "C" {
 #include "textrender.h"
 #include "util.h"
 #include "keyloader.h"
+#include "trace.h"
 
 void defaultSettings(QSettings* settings);
 void copyFileFromResources(QString from, QString to);
@@ -50,6 +51,12 @@ int main(int argc, char *argv[])
     QSettings *settings = new QSettings(QDir::homePath()+"/.config/ToeTerm/settings.ini", QSettings::IniFormat);
     defaultSettings(settings);
 
+    QString recordFile = settings->value("terminal/recordFile").toString();
+    for(int i=1; i<argc-1; i++) {
+        if( QString(argv[i]) == "--record" )
+            recordFile = QString(argv[i+1]);
+    }
+
     // fork the child process before creating QGuiApplication
     int socketM;
     int pid = forkpty(&socketM,NULL,NULL,NULL);
@@ -114,7 +121,11 @@ int main(int argc, char *argv[])
 
     Terminal term;
     Util util(settings);
-    term.setUtil(&util);
+    term.setClipboard(&util);
+    term.setBell(&util);
+    term.setSettings(&util);
+    QObject::connect(&term,SIGNAL(windowTitleChanged(QString)),&util,SLOT(setWindowTitle(QString)));
+    QObject::connect(&term,SIGNAL(selectionFinished()),&util,SLOT(selectionFinished()));
     QString startupErrorMsg;
 
     // copy the default config files to the config dir if they don't already exist
@@ -131,6 +142,9 @@ int main(int argc, char *argv[])
     copyFileFromResources(":/data/Solarized_Dark_Alternative.colors", util.configPath()+"/Solarized_Dark_Alternative.colors");
     copyFileFromResources(":/data/Solarized_Light.colors", util.configPath()+"/Solarized_Light.colors");
 
+    // only in a build with CONFIG+=trace
+    Trace::start(util.configPath()+"/trace.json");
+
     KeyLoader keyLoader;
     keyLoader.setUtil(&util);
     bool ret = keyLoader.loadLayout( settings->value("ui/keyboardLayout").toString() );
@@ -163,15 +177,15 @@ int main(int argc, char *argv[])
         QMetaObject::invokeMethod(win, "showErrorMessage", Qt::QueuedConnection, Q_ARG(QVariant, startupErrorMsg));
 
     TextRender *tr = root->findChild<TextRender*>("textrender");
-    tr->setUtil(&util);
+    tr->setSettings(&util);
     tr->setTerminal(&term);
-    term.setRenderer(tr);
     util.setTerm(&term);
     util.setRenderer(tr);
 
     tr->loadColorScheme(settings->value("ui/colorScheme").toString());
 
     QObject::connect(&term,SIGNAL(displayBufferChanged()),win,SLOT(displayBufferChanged()));
+    QObject::connect(app,SIGNAL(applicationStateChanged(Qt::ApplicationState)),&term,SLOT(applicationStateChanged(Qt::ApplicationState)));
     QObject::connect(view->engine(),SIGNAL(quit()),app,SLOT(quit()));
 
     PtyIFace ptyiface(pid, socketM, &term,
@@ -182,12 +196,17 @@ int main(int argc, char *argv[])
 
     context->setContextProperty( "ptyiface", &ptyiface );
 
+    if(!recordFile.isEmpty())
+        ptyiface.startRecording(recordFile);
+
     view->showFullScreen();
 
     util.updateSwipeLock(false);
     util.updateSwipeLock(true);
 
-    return app->exec();
+    const int exitCode = app->exec();
+    Trace::stop();
+    return exitCode;
 }
 
 void defaultSettings(QSettings* settings)
@@ -205,6 +224,10 @@ void defaultSettings(QSettings* settings)
         settings->setValue("terminal/envVarTERM", "xterm-256color");
     if(!settings->contains("terminal/charset"))
         settings->setValue("terminal/charset", "UTF-8");
+    if(!settings->contains("terminal/recordFile"))
+        settings->setValue("terminal/recordFile", "");  // asciicast v2, for reproducing problems
+    if(!settings->contains("terminal/allowClipboardWrite"))
+        settings->setValue("terminal/allowClipboardWrite", false);  // OSC 52, any output could set the clipboard
 
     if(!settings->contains("ui/keyboardLayout"))
         settings->setValue("ui/keyboardLayout", "english");
@@ -238,6 +261,10 @@ void defaultSettings(QSettings* settings)
         settings->setValue("ui/dragMode", "scroll");  // "gestures, "scroll", "select" ("off" would also be ok)
     if(!settings->contains("ui/specialKeys"))
         settings->setValue("ui/specialKeys", false);
+    if(!settings->contains("ui/showLatency"))
+        settings->setValue("ui/showLatency", false);  // key press to frame latency overlay
+    if(!settings->contains("ui/showPerformanceHud"))
+        settings->setValue("ui/showPerformanceHud", false);
 
     if(!settings->contains("state/createdByVersion"))
         settings->setValue("state/createdByVersion", "1.6");
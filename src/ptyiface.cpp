@@ -20,6 +20,10 @@
 */
 
 #include <QCoreApplication>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 
 extern "C" {
 #include <pty.h>
@@ -35,6 +39,7 @@ extern "C" {
 
 #include "terminal.h"
 #include "ptyiface.h"
+#include "trace.h"
 
 static bool childProcessQuit = false;
 static int childProcessPid = 0;
@@ -59,7 +64,10 @@ PtyIFace::PtyIFace(int pid, int masterFd, Terminal *term, QString charset, QObje
     iMasterFd(masterFd),
     iFailed(false),
     iReadNotifier(0),
-    iTextCodec(0)
+    iPendingPos(0),
+    iCoalesceDelay(0),
+    iTextCodec(0),
+    iTextDecoder(0)
 {
     childProcessPid = iPid;
 
@@ -76,6 +84,14 @@ PtyIFace::PtyIFace(int pid, int masterFd, Terminal *term, QString charset, QObje
     iReadNotifier = new QSocketNotifier(iMasterFd, QSocketNotifier::Read, this);
     connect(iReadNotifier,SIGNAL(activated(int)),this,SLOT(readActivated()));
 
+    iParseTimer.setSingleShot(true);
+    iParseTimer.setInterval(0);
+    connect(&iParseTimer,SIGNAL(timeout()),this,SLOT(parsePending()));
+
+    iReadTimer.setSingleShot(true);
+    iReadTimer.setTimerType(Qt::PreciseTimer);
+    connect(&iReadTimer,SIGNAL(timeout()),this,SLOT(readPending()));
+
     signal(SIGCHLD,&sighandler);
     fcntl(iMasterFd, F_SETFL, O_NONBLOCK); // reads from the descriptor should be non-blocking
 
@@ -85,6 +101,7 @@ PtyIFace::PtyIFace(int pid, int masterFd, Terminal *term, QString charset, QObje
         iTextCodec = QTextCodec::codecForName("UTF-8");
     if (!iTextCodec)
         qFatal("No valid text codec");
+    iTextDecoder = iTextCodec->makeDecoder();
 }
 
 PtyIFace::~PtyIFace()
@@ -96,18 +113,81 @@ PtyIFace::~PtyIFace()
         int status=0;
         waitpid(-1,&status,0);
     }
+    delete iTextDecoder;
 }
 
 void PtyIFace::readActivated()
 {
+    // a child writing a line at a time wakes us up for every line; while
+    // output keeps coming, wait a little for more so that one parse and one
+    // repaint cover several writes. Output that follows a key press is most
+    // likely its echo and is read at once.
+    const bool busy = iLastRead.isValid() && !iLastRead.hasExpired(busyInterval);
+    const bool echo = iLastWrite.isValid() && !iLastWrite.hasExpired(echoInterval);
+    if(!busy || echo)
+        iCoalesceDelay = 0;
+    else
+        iCoalesceDelay = qMin(iCoalesceDelay+1, maxCoalesceDelay);
+
+    if(iCoalesceDelay == 0) {
+        readPending();
+    } else {
+        iReadNotifier->setEnabled(false);
+        iReadTimer.start(iCoalesceDelay);
+    }
+}
+
+void PtyIFace::readPending()
+{
+    iLastRead.start();
+
     QByteArray data;
     readTerm(data);
-    if(iTerm)
-        iTerm->insertInBuffer( iTextCodec->toUnicode(data) );
+    if(data.isEmpty()) {
+        iReadNotifier->setEnabled(true);
+        return;
+    }
+
+    iTerm->latency().echoed();
+    iTerm->countRead(data.size());
+    iPending = iTextDecoder->toUnicode(data);
+    iPendingPos = 0;
+    if(iRecordFile.isOpen())
+        recordEvent("o", iPending);
+    parsePending();
+}
+
+void PtyIFace::parsePending()
+{
+    // parse in slices and return to the event loop once the time budget is
+    // used, so that key presses (like ^C) still get through while a program
+    // floods the terminal; reading resumes when everything has been parsed
+    QElapsedTimer timer;
+    timer.start();
+    while(iTerm && iPendingPos < iPending.size() && !timer.hasExpired(parseBudget)) {
+        const int n = qMin(parseSliceSize, iPending.size()-iPendingPos);
+        iTerm->insertInBuffer(iPending.mid(iPendingPos, n));
+        iPendingPos += n;
+    }
+
+    if(iTerm && iPendingPos < iPending.size()) {
+        iReadNotifier->setEnabled(false);
+        iParseTimer.start();
+    } else {
+        iPending.clear();
+        iPendingPos = 0;
+        iReadNotifier->setEnabled(true);
+    }
 }
 
 void PtyIFace::changeCharset(QString charset_name) {
-    iTextCodec = QTextCodec::codecForName(charset_name.toLatin1());
+    QTextCodec *codec = QTextCodec::codecForName(charset_name.toLatin1());
+    if (!codec)
+        return;
+
+    iTextCodec = codec;
+    delete iTextDecoder;
+    iTextDecoder = iTextCodec->makeDecoder();
 }
 
 void PtyIFace::resize(QSize newSize)
@@ -115,11 +195,54 @@ void PtyIFace::resize(QSize newSize)
     if(childProcessQuit)
         return;
 
+    // every TIOCSWINSZ sends SIGWINCH and makes full screen programs redraw
+    if(newSize == iWinSize)
+        return;
+    iWinSize = newSize;
+
     winsize winp;
     winp.ws_col = newSize.width();
     winp.ws_row = newSize.height();
 
     ioctl(iMasterFd, TIOCSWINSZ, &winp);
+
+    if(iRecordFile.isOpen())
+        recordEvent("r", QString("%1x%2").arg(newSize.width()).arg(newSize.height()));
+}
+
+bool PtyIFace::startRecording(const QString &path)
+{
+    iRecordFile.setFileName(path);
+    if(!iRecordFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "cannot record to" << path << iRecordFile.errorString();
+        return false;
+    }
+
+    QJsonObject header;
+    header.insert("version", 2);
+    header.insert("width", iTerm->termSize().width());
+    header.insert("height", iTerm->termSize().height());
+    header.insert("timestamp", double(QDateTime::currentMSecsSinceEpoch() / 1000));
+    header.insert("title", QString("toeterm"));
+    iRecordFile.write(QJsonDocument(header).toJson(QJsonDocument::Compact));
+    iRecordFile.write("\n");
+    iRecordFile.flush();
+
+    iRecordClock.start();
+    return true;
+}
+
+void PtyIFace::recordEvent(const QString &type, const QString &data)
+{
+    // the text is recorded as decoded, which is also what the terminal
+    // is fed, so a replay goes through exactly the same input
+    QJsonArray event;
+    event.append(iRecordClock.nsecsElapsed() / 1e9);
+    event.append(type);
+    event.append(data);
+    iRecordFile.write(QJsonDocument(event).toJson(QJsonDocument::Compact));
+    iRecordFile.write("\n");
+    iRecordFile.flush();
 }
 
 void PtyIFace::writeTerm(const QString &chars)
@@ -129,24 +252,30 @@ void PtyIFace::writeTerm(const QString &chars)
 
 void PtyIFace::writeTerm(const QByteArray &chars)
 {
+    TRACE_SCOPE("PtyIFace::writeTerm");
+
     if(childProcessQuit)
         return;
 
+    iLastWrite.start();
     int ret = write(iMasterFd, chars, chars.size());
     if(ret != chars.size())
         qDebug() << "write error!";
+    iTerm->latency().written();
 }
 
 void PtyIFace::readTerm(QByteArray &chars)
 {
+    TRACE_SCOPE("PtyIFace::readTerm");
+
     if(childProcessQuit)
         return;
 
-    int ret = 0;
-    char ch[64];
-    while(ret != -1) {
-        ret = read(iMasterFd, &ch, 64);
-        if(ret > 0)
-            chars.append((char*)&ch, ret);
+    char ch[readChunkSize];
+    while(chars.size() < maxReadSize) {
+        int ret = read(iMasterFd, &ch, readChunkSize);
+        if(ret <= 0)
+            break;
+        chars.append((char*)&ch, ret);
     }
 }
@@ -25,6 +25,9 @@
 #include <QByteArray>
 #include <QSize>
 #include <QTextCodec>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QFile>
 
 class Terminal;
 
@@ -37,6 +40,7 @@ public:
 
     void writeTerm(const QString &chars);
     bool failed() { return iFailed; }
+    bool startRecording(const QString& path);
 
     Q_INVOKABLE void changeCharset(QString charset_name);
 
@@ -45,12 +49,22 @@ public slots:
 
 private slots:
     void readActivated();
+    void readPending();
+    void parsePending();
 
 private:
     Q_DISABLE_COPY(PtyIFace)
+    static const int readChunkSize = 4096;
+    static const int maxReadSize = 64*1024;  // per wakeup, the rest stays in the pty
+    static const int parseSliceSize = 4096;  // characters
+    static const int parseBudget = 8;        // ms before going back to the event loop
+    static const int busyInterval = 10;      // ms, output this soon after a read counts as a stream
+    static const int echoInterval = 50;      // ms, output this soon after a write is read at once
+    static const int maxCoalesceDelay = 4;   // ms
 
     void writeTerm(const QByteArray &chars);
     void readTerm(QByteArray &chars);
+    void recordEvent(const QString& type, const QString& data);
 
     Terminal *iTerm;
     int iPid;
@@ -59,7 +73,26 @@ private:
 
     QSocketNotifier *iReadNotifier;
 
+    // decoded output not parsed yet; the notifier is off until it is
+    QString iPending;
+    int iPendingPos;
+    QTimer iParseTimer;
+
+    // delay between a wakeup and the read, grows while output keeps coming
+    int iCoalesceDelay;
+    QTimer iReadTimer;
+    QElapsedTimer iLastRead;
+    QElapsedTimer iLastWrite;
+
+    // session recording in asciicast v2 format
+    QFile iRecordFile;
+    QElapsedTimer iRecordClock;
+
+    QSize iWinSize;
+
     QTextCodec *iTextCodec;
+    // keeps the state of a multibyte sequence split between two reads
+    QTextDecoder *iTextDecoder;
 };
 
 #endif // PTYIFACE_H
@@ -0,0 +1,125 @@
+/*
+    ThumbTerm Copyright Olli Vanhoja
+    FingerTerm Copyright 2011-2012 Heikki Holstila <heikki.holstila@gmail.com>
+    ToeTerm Copyright 2018 ROZZ, 2019 Matti Viljanen
+
+    This file is part of ToeTerm.
+
+    ToeTerm is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    ToeTerm is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ToeTerm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QCryptographicHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "replay.h"
+#include "terminal.h"
+
+Replay::Replay(Terminal* term) :
+    iTerm(term),
+    iEvents(0),
+    iBytes(0),
+    iParseNsecs(0)
+{
+}
+
+bool Replay::run(const QString& path, bool realtime)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "cannot open" << path << file.errorString();
+        return false;
+    }
+
+    const QJsonObject header = QJsonDocument::fromJson(file.readLine()).object();
+    if(header.value("version").toInt() != 2) {
+        qWarning() << path << "is not an asciicast v2 recording";
+        return false;
+    }
+    QSize size(header.value("width").toInt(), header.value("height").toInt());
+    if(size.isEmpty())
+        size = QSize(80, 24);  // recorded before the window had a size, a resize follows
+    iTerm->setTermSize(size);
+
+    iClock.start();
+    while(!file.atEnd()) {
+        const QJsonArray event = QJsonDocument::fromJson(file.readLine()).array();
+        if(event.size() < 3)
+            continue;
+
+        if(realtime)
+            waitUntil(qint64(event.at(0).toDouble() * 1000));
+
+        const QString type = event.at(1).toString();
+        const QString data = event.at(2).toString();
+        if(type == "o") {
+            QElapsedTimer timer;
+            timer.start();
+            iTerm->insertInBuffer(data);
+            iParseNsecs += timer.nsecsElapsed();
+            iBytes += data.toUtf8().size();
+            iEvents++;
+        }
+        else if(type == "r") {
+            const QStringList size = data.split('x');
+            if(size.count() == 2)
+                iTerm->setTermSize(QSize(size.at(0).toInt(), size.at(1).toInt()));
+        }
+    }
+
+    return true;
+}
+
+void Replay::waitUntil(qint64 msecs)
+{
+    while(iClock.elapsed() < msecs) {
+        QCoreApplication::processEvents();
+        QThread::msleep(qMin<qint64>(10, msecs - iClock.elapsed()));
+    }
+}
+
+void Replay::printReport()
+{
+    const double seconds = iParseNsecs / 1e9;
+    QTextStream out(stdout);
+    out << "events:         " << iEvents << endl;
+    out << "bytes:          " << iBytes << endl;
+    out << "parse time:     " << QString::number(seconds * 1000, 'f', 2) << " ms" << endl;
+    out << "throughput:     " << QString::number(seconds > 0 ? iBytes / seconds / 1e6 : 0, 'f', 2) << " MB/s" << endl;
+    out << "sequences:      " << iTerm->stats().sequences << endl;
+    out << "scrolled lines: " << iTerm->stats().scrolledLines << endl;
+    out << "screen size:    " << iTerm->termSize().width() << "x" << iTerm->termSize().height() << endl;
+    out << "screen hash:    " << screenHash(iTerm) << endl;
+}
+
+QByteArray Replay::screenHash(Terminal* term)
+{
+    // covers the visible cells and the cursor, rows padded to the width so
+    // that the same screen hashes the same however the rows are stored
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    const QSize size = term->termSize();
+    for(int y=0; y<size.height(); y++) {
+        const QList<TermChar> row = y < term->buffer().size() ? term->buffer().at(y) : QList<TermChar>();
+        for(int x=0; x<size.width(); x++) {
+            const TermChar ch = x < row.size() ? row.at(x) : term->zeroChar;
+            const quint32 cell[4] = { ch.c, quint32(ch.fgColor), quint32(ch.bgColor), quint32(ch.attrib) };
+            hash.addData(reinterpret_cast<const char*>(cell), sizeof(cell));
+        }
+    }
+    const QPoint cursor = term->cursorPos();
+    const qint32 pos[2] = { cursor.x(), cursor.y() };
+    hash.addData(reinterpret_cast<const char*>(pos), sizeof(pos));
+    return hash.result().toHex();
+}
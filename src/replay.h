@@ -0,0 +1,55 @@
+/*
+    ThumbTerm Copyright Olli Vanhoja
+    FingerTerm Copyright 2011-2012 Heikki Holstila <heikki.holstila@gmail.com>
+    ToeTerm Copyright 2018 ROZZ, 2019 Matti Viljanen
+
+    This file is part of ToeTerm.
+
+    ToeTerm is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    ToeTerm is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ToeTerm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <QtCore>
+
+class Terminal;
+
+// Feeds a session recorded with --record (asciicast v2) into a terminal
+// without a window or a child process, and reports how fast it was parsed
+// and what the screen ended up as.
+class Replay
+{
+public:
+    explicit Replay(Terminal* term);
+
+    bool run(const QString& path, bool realtime);
+    void printReport();
+
+    static QByteArray screenHash(Terminal* term);
+
+private:
+    Q_DISABLE_COPY(Replay)
+
+    void waitUntil(qint64 msecs);
+
+    Terminal* iTerm;
+    QElapsedTimer iClock;
+
+    int iEvents;
+    qint64 iBytes;
+    qint64 iParseNsecs;
+};
+
+#endif // REPLAY_H
@@ -19,17 +19,43 @@
     along with ToeTerm.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <QGuiApplication>
-#include <QClipboard>
 #include <QDebug>
 
 #include "terminal.h"
+#include "terminalinterfaces.h"
+#include "charwidth.h"
 #include "ptyiface.h"
-#include "textrender.h"
-#include "util.h"
+#include "trace.h"
+
+// Translation tables for the character sets that can be designated to
+// G0-G3, indexed by the character as received
+struct CharsetTables {
+    uint decGraphics[256];
+    uint british[256];
+
+    CharsetTables() {
+        // DEC special graphics replace 0x5f-0x7e
+        static const uint dec[32] = {
+            0x00A0, 0x25C6, 0x2592, 0x2409, 0x240C, 0x240D, 0x240A, 0x00B0,
+            0x00B1, 0x2424, 0x240B, 0x2518, 0x2510, 0x250C, 0x2514, 0x253C,
+            0x23BA, 0x23BB, 0x2500, 0x23BC, 0x23BD, 0x251C, 0x2524, 0x2534,
+            0x252C, 0x2502, 0x2264, 0x2265, 0x03C0, 0x2260, 0x00A3, 0x00B7
+        };
+
+        for (uint i=0; i<256; i++) {
+            decGraphics[i] = i;
+            british[i] = i;
+        }
+        for (int i=0; i<32; i++)
+            decGraphics[0x5F+i] = dec[i];
+        british['#'] = 0x00A3;
+    }
+};
+
+static const CharsetTables charsetTables;
 
 Terminal::Terminal(QObject *parent) :
-    QObject(parent), iRenderer(0), iPtyIFace(0), iUtil(0),
+    QObject(parent), iPtyIFace(0), iClipboard(0), iBell(0), iSettings(0),
     iTermSize(0,0), iEmitCursorChangeSignal(true),
     iShowCursor(true), iUseAltScreenBuffer(false), iAppCursorKeys(false)
 {
@@ -39,34 +65,37 @@ Terminal::Terminal(QObject *parent) :
     zeroChar.attrib = 0;
 
     escape = -1;
+    resetOsc();
+    iStats = TermStats();
+    iHighSurrogate = 0;
 
     iTermAttribs.currentFgColor = defaultFgColor;
     iTermAttribs.currentBgColor = defaultBgColor;
     iTermAttribs.currentAttrib = 0;
     iTermAttribs.cursorPos = QPoint(0,0);
+    resetCharsets();
     iMarginBottom = 0;
     iMarginTop = 0;
+    iMarginLeft = 1;
+    iMarginRight = 0;
+    iMarginWrapPending = false;
 
     resetBackBufferScrollPos();
 
     iTermAttribs_saved = iTermAttribs;
     iTermAttribs_saved_alt = iTermAttribs;
 
-    resetTerminal();
-}
+    iSyncUpdate = false;
+    iSyncTimer.setSingleShot(true);
+    iSyncTimer.setInterval(syncUpdateTimeout);
+    connect(&iSyncTimer, SIGNAL(timeout()), this, SLOT(endSyncUpdate()));
 
-void Terminal::setRenderer(TextRender* tr)
-{
-    iRenderer = tr;
+    iBackground = false;
+    iBackgroundDirty = false;
+    iBackgroundTimer.setInterval(backgroundRefreshInterval);
+    connect(&iBackgroundTimer, SIGNAL(timeout()), this, SLOT(backgroundRefresh()));
 
-    if(tr) {
-        tr->updateTermSize();
-        connect(this, SIGNAL(displayBufferChanged()), tr, SLOT(redraw()));
-        connect(this, SIGNAL(cursorPosChanged(QPoint)), tr, SLOT(redraw()));
-        connect(this, SIGNAL(termSizeChanged(QSize)), tr, SLOT(redraw()));
-    } else {
-        qDebug() << "warning: null text renderer";
-    }
+    resetTerminal();
 }
 
 void Terminal::setPtyIFace(PtyIFace *pty)
@@ -79,6 +108,7 @@ void Terminal::setPtyIFace(PtyIFace *pty)
 
 void Terminal::setCursorPos(QPoint pos)
 {
+    iMarginWrapPending = false;
     if( iTermAttribs.cursorPos != pos ) {
         int tlimit = 1;
         int blimit = iTermSize.height();
@@ -126,8 +156,13 @@ QList<QList<TermChar> >& Terminal::buffer()
 void Terminal::setTermSize(QSize size)
 {
     if( iTermSize != size ) {
+        if (iTermSize.width() > 0 && size.width() > 0 && iTermSize.width() != size.width())
+            reflowScreen(size);
+
         iMarginTop = 1;
         iMarginBottom = size.height();
+        iMarginLeft = 1;
+        iMarginRight = size.width();
         iTermSize=size;
 
         resetTabs();
@@ -136,6 +171,18 @@ void Terminal::setTermSize(QSize size)
     }
 }
 
+static bool charIsHexDigit(QChar ch)
+{
+    if (ch.isDigit()) // 0-9
+        return true;
+    else if (ch.toLatin1() >= 65 && ch.toLatin1() <= 70) // A-F
+        return true;
+    else if (ch.toLatin1() >= 97 && ch.toLatin1() <= 102) // a-f
+        return true;
+
+    return false;
+}
+
 void Terminal::putString(QString str, bool unEscape)
 {
     if (unEscape) {
@@ -149,7 +196,7 @@ void Terminal::putString(QString str, bool unEscape)
         while(str.indexOf("\\x") != -1) {
             int i = str.indexOf("\\x")+2;
             QString num;
-            while(num.length() < 2 && str.length()>i && Util::charIsHexDigit(str.at(i))) {
+            while(num.length() < 2 && str.length()>i && charIsHexDigit(str.at(i))) {
                 num.append(str.at(i));
                 i++;
             }
@@ -180,6 +227,7 @@ void Terminal::keyPress(int key, int modifiers)
 {
     QChar c(key);
 
+    iLatency.keyPressed();
     resetBackBufferScrollPos();
 
     if (c.isLetter()) {
@@ -258,12 +306,15 @@ void Terminal::keyPress(int key, int modifiers)
 
 void Terminal::insertInBuffer(const QString& chars)
 {
+    TRACE_SCOPE("Terminal::insertInBuffer");
+
     if(iTermSize.isNull()) {
         qDebug() << "null size terminal";
         return;
     }
 
     iEmitCursorChangeSignal = false;
+    iStats.chars += chars.size();
 
     QChar ch;
     char latin;
@@ -286,7 +337,10 @@ void Terminal::insertInBuffer(const QString& chars)
             }
         }
         else if(latin=='\r') {  // carriage return
-            setCursorPos(QPoint(1,cursorPos().y()));
+            if(hasColumnMargins() && cursorPos().x() >= iMarginLeft)
+                setCursorPos(QPoint(iMarginLeft,cursorPos().y()));
+            else
+                setCursorPos(QPoint(1,cursorPos().y()));
         }
         else if(latin=='\b' || latin==127) {  //backspace & del (only move cursor, don't erase)
             setCursorPos(QPoint(cursorPos().x()-1,cursorPos().y()));
@@ -294,10 +348,9 @@ void Terminal::insertInBuffer(const QString& chars)
         else if(latin=='\a') {  // BEL
             if(escape==']') {  // BEL also ends OSC sequence
                 escape=-1;
-                oscSequence(oscSeq);
-                oscSeq.clear();
-            } else {
-                iUtil->bellAlert();
+                finishOsc();
+            } else if(iBell) {
+                iBell->bellAlert();
             }
         }
         else if(latin=='\t') {  //tab
@@ -310,17 +363,24 @@ void Terminal::insertInBuffer(const QString& chars)
                 }
             }
         }
-        else if(latin==14 || latin==15) {  //SI and SO, related to character set... ignore
+        else if(latin==14) {  // SO, G1 into GL
+            iTermAttribs.glCharset = 1;
+        }
+        else if(latin==15) {  // SI, G0 into GL
+            iTermAttribs.glCharset = 0;
         }
         else {
             if( escape>=0 ) {
+                if( escape==0 && latin!='\\' && iOscCommand!=oscNone )
+                    resetOsc();  // ESC without the rest of ST, the OSC is abandoned
+
                 if( escape==0 && (latin=='[') ) {
                     escape='['; //ansi sequence
                     escSeq += ch;
                 }
                 else if( escape==0 && (latin==']') ) {
                     escape=']'; //osc sequence
-                    oscSeq += ch;
+                    iOscCommand = oscPrefix;
                 }
                 else if( escape==0 && multiCharEscapes.contains(latin)) {
                     escape = latin;
@@ -328,17 +388,26 @@ void Terminal::insertInBuffer(const QString& chars)
                 }
                 else if( escape==0 && latin=='\\' ) {  // ESC\ also ends OSC sequence
                     escape=-1;
-                    oscSequence(oscSeq);
-                    oscSeq.clear();
+                    finishOsc();
                 }
                 else if (latin==ch_ESC) {
                     escape = 0;
+                    escSeq.clear();
+                }
+                else if( escape==escapeDiscard ) {
+                    // skip to the final byte
                 }
                 else if( escape=='[' || multiCharEscapes.contains(escape) ) {
-                    escSeq += ch;
+                    if(escSeq.length() < maxEscSeqLength) {
+                        escSeq += ch;
+                    } else {
+                        qDebug() << "escape sequence too long, discarding";
+                        escape = escapeDiscard;
+                        escSeq.clear();
+                    }
                 }
                 else if( escape==']' ) {
-                    oscSeq += ch;
+                    oscChar(ch);
                 }
                 else if( multiCharEscapes.contains(escape) ) {
                     escSeq += ch;
@@ -348,6 +417,9 @@ void Terminal::insertInBuffer(const QString& chars)
                     escape=-1;
                 }
 
+                if( escape==escapeDiscard && latin >= 64 && latin <= 126 ) {
+                    escape=-1;
+                }
                 if( escape=='[' && latin >= 64 && latin <= 126 && latin != '[' ) {
                     ansiSequence(escSeq);
                     escape=-1;
@@ -359,8 +431,29 @@ void Terminal::insertInBuffer(const QString& chars)
                     escSeq.clear();
                 }
             } else {
-                if (ch.isPrint())
-                    insertAtCursor(ch, !iReplaceMode);
+                uint code = ch.unicode();
+                if (ch.isHighSurrogate()) {
+                    // the low half may only come with the next chunk
+                    if (i+1 == chars.size()) {
+                        iHighSurrogate = ch.unicode();
+                        continue;
+                    }
+                    if (chars.at(i+1).isLowSurrogate())
+                        code = QChar::surrogateToUcs4(ch, chars.at(++i));
+                }
+                else if (ch.isLowSurrogate() && iHighSurrogate) {
+                    code = QChar::surrogateToUcs4(iHighSurrogate, ch.unicode());
+                }
+                iHighSurrogate = 0;
+
+                const int charset = iSingleShift >= 0 ? iSingleShift : iTermAttribs.glCharset;
+                const uint* table = iTermAttribs.charsets[charset];
+                if (table && code < 256)
+                    code = table[code];
+                iSingleShift = -1;
+
+                if (QChar::isPrint(code) || code == 0x200D)  // zero width joiner
+                    insertAtCursor(code, !iReplaceMode);
                 else if (latin==ch_ESC)
                     escape=0;
                 else if (latin != 0)
@@ -370,77 +463,434 @@ void Terminal::insertInBuffer(const QString& chars)
     }
 
     iEmitCursorChangeSignal = true;
+    bufferChanged();
+}
+
+void Terminal::bufferChanged()
+{
+    if(iSyncUpdate)
+        return;
+    if(iBackground) {
+        iBackgroundDirty = true;
+        return;
+    }
+    emit displayBufferChanged();
+}
+
+void Terminal::setBackground(bool background)
+{
+    if(iBackground == background)
+        return;
+    iBackground = background;
+
+    if(background) {
+        iBackgroundDirty = false;
+        iBackgroundTimer.start();
+        emit displayBufferChanged();  // the cover starts from the current screen
+    } else {
+        iBackgroundTimer.stop();
+        if(iBackgroundDirty)
+            emit displayBufferChanged();
+    }
+}
+
+void Terminal::applicationStateChanged(Qt::ApplicationState state)
+{
+    setBackground(state != Qt::ApplicationActive);
+}
+
+void Terminal::backgroundRefresh()
+{
+    // while only the cover shows the terminal, output is parsed as usual
+    // but whatever it did in between is shown only now and then
+    if(!iBackgroundDirty)
+        return;
+    iBackgroundDirty = false;
     emit displayBufferChanged();
 }
 
-void Terminal::insertAtCursor(QChar c, bool overwriteMode, bool advanceCursor)
+void Terminal::beginSyncUpdate()
+{
+    // restarting the timer on a repeated begin marker keeps a frame from
+    // being cut short, but a client that never ends it is still bounded
+    iSyncUpdate = true;
+    iSyncTimer.start();
+}
+
+void Terminal::endSyncUpdate()
+{
+    iSyncTimer.stop();
+    if(!iSyncUpdate)
+        return;
+    iSyncUpdate = false;
+    bufferChanged();
+}
+
+int Terminal::privateModeState(int mode)
+{
+    // DECRQM: 1 = set, 2 = reset, 0 = not recognized
+    switch(mode) {
+    case 1:    return iAppCursorKeys ? 1 : 2;
+    case 6:    return iTermAttribs.originMode ? 1 : 2;
+    case 7:    return iTermAttribs.wrapAroundMode ? 1 : 2;
+    case 25:   return iShowCursor ? 1 : 2;
+    case 69:   return iColumnMarginMode ? 1 : 2;
+    case 1049: return iUseAltScreenBuffer ? 1 : 2;
+    case 2026: return iSyncUpdate ? 1 : 2;
+    default:   return 0;
+    }
+}
+
+void Terminal::insertAtCursor(uint c, bool overwriteMode, bool advanceCursor)
 {
-    if(cursorPos().x() > iTermSize.width() && advanceCursor) {
+    const int width = charWidth(c);
+
+    // combining marks and other zero width characters, and whatever follows
+    // a zero width joiner, belong to the character before the cursor;
+    // anything else does not look at clusters at all
+    if(width == 0) {
+        if(advanceCursor && appendToCluster(c, false))
+            iPendingJoiner = (c == 0x200D);
+        return;
+    }
+    if(iPendingJoiner) {
+        iPendingJoiner = false;
+        if(advanceCursor && appendToCluster(c, true))
+            return;
+    }
+
+    // text written between the left and right margins wraps at the right one
+    const bool inMargins = hasColumnMargins() &&
+            (iMarginWrapPending || insideColumnMargins(cursorPos().x()));
+    const int left = inMargins ? iMarginLeft : 1;
+    const int right = inMargins ? iMarginRight : iTermSize.width();
+
+    // a wide character that no longer fits on the line wraps as a whole
+    const bool wrap = cursorPos().x() > right ||
+            (width == 2 && cursorPos().x() == right && right > left);
+
+    if(wrap && advanceCursor) {
         if(iTermAttribs.wrapAroundMode) {
+            // mark the line as continuing on the next one, so that a resize
+            // can join them again
+            if(!inMargins) {
+                QList<TermChar> &wrapped = currentLine();
+                const int length = qMin(cursorPos().x(), iTermSize.width()+1) - 1;
+                while(wrapped.size() > length)
+                    wrapped.removeLast();
+                while(wrapped.size() < length)
+                    wrapped.append(zeroChar);
+                if(!wrapped.isEmpty())
+                    wrapped.last().attrib |= attribWrapped;
+            }
+
             if(cursorPos().y()>=iMarginBottom) {
                 scrollFwd(1);
-                setCursorPos(QPoint(1, cursorPos().y()));
+                setCursorPos(QPoint(left, cursorPos().y()));
             } else {
-                setCursorPos(QPoint(1, cursorPos().y()+1));
+                setCursorPos(QPoint(left, cursorPos().y()+1));
             }
         } else {
-            setCursorPos(QPoint(iTermSize.width(), cursorPos().y()));
+            setCursorPos(QPoint(qMax(left, right-width+1), cursorPos().y()));
         }
     }
 
     QList<TermChar> &curLine = currentLine();
+    const int x = cursorPos().x()-1;
 
-    while(curLine.size() < cursorPos().x() )
+    while(curLine.size() < x+width)
         curLine.append(zeroChar);
 
-    if(!overwriteMode)
-        curLine.insert(cursorPos().x()-1,zeroChar);
+    if(!overwriteMode) {
+        for(int i=0; i<width; i++)
+            curLine.insert(x,zeroChar);
+    }
 
-    curLine[cursorPos().x()-1].c = c;
-    curLine[cursorPos().x()-1].fgColor = iTermAttribs.currentFgColor;
-    curLine[cursorPos().x()-1].bgColor = iTermAttribs.currentBgColor;
-    curLine[cursorPos().x()-1].attrib = iTermAttribs.currentAttrib;
+    // overwriting one half of a wide character blanks the other half
+    if(x > 0 && (curLine.at(x).attrib & attribWideTail))
+        curLine[x-1].c = ' ';
+    if(x+width < curLine.size() && (curLine.at(x+width).attrib & attribWideTail)) {
+        curLine[x+width].c = ' ';
+        curLine[x+width].attrib &= ~attribWideTail;
+    }
+
+    curLine[x].c = c;
+    curLine[x].fgColor = iTermAttribs.currentFgColor;
+    curLine[x].bgColor = iTermAttribs.currentBgColor;
+    curLine[x].attrib = iTermAttribs.currentAttrib;
+
+    // the second cell of a wide character only carries its colors
+    if(width == 2) {
+        curLine[x+1] = curLine.at(x);
+        curLine[x+1].c = ' ';
+        curLine[x+1].attrib |= attribWideTail;
+    }
 
     if (advanceCursor) {
-        setCursorPos(QPoint(cursorPos().x()+1,cursorPos().y()));
+        setCursorPos(QPoint(cursorPos().x()+width,cursorPos().y()));
+        iMarginWrapPending = inMargins && cursorPos().x() > iMarginRight;
+        iLastChar = c;
     }
 }
 
-void Terminal::deleteAt(QPoint pos)
+bool Terminal::appendToCluster(uint c, bool afterJoinerOnly)
 {
-    clearAt(pos);
-    QList<TermChar> &curLine = buffer()[pos.y()-1];
-    for (int i = pos.x(); i < curLine.length(); i++) {
-        curLine[i - 1].c = curLine[i].c;
-        curLine[i - 1].fgColor = curLine[i].fgColor;
-        curLine[i - 1].bgColor = curLine[i].bgColor;
-        curLine[i - 1].attrib = curLine[i].attrib;
-    }
-    curLine[curLine.length() - 1].c = ' ';
-    curLine[curLine.length() - 1].fgColor = iTermAttribs.currentFgColor;
-    curLine[curLine.length() - 1].bgColor = iTermAttribs.currentBgColor;
-    curLine[curLine.length() - 1].attrib = iTermAttribs.currentAttrib;
+    QList<TermChar> &line = currentLine();
+    int x = qMin(cursorPos().x(), iTermSize.width()+1) - 2;
+    if(x > 0 && x < line.size() && (line.at(x).attrib & attribWideTail))
+        x--;
+    if(x < 0 || x >= line.size())
+        return false;
+
+    TermChar &prev = line[x];
+    if(afterJoinerOnly && (prev.c < clusterBase || !cluster(prev.c).endsWith(QChar(0x200D))))
+        return false;
+
+    prev.c = internCluster(cellText(prev.c) + QString::fromUcs4(&c, 1));
+    return true;
 }
 
-void Terminal::clearAt(QPoint pos)
+uint Terminal::internCluster(const QString& text)
 {
-    if(pos.y() <= 0 || pos.y()-1 > buffer().size() ||
-            pos.x() <= 0 || pos.x()-1 > buffer()[pos.y()-1].size())
-    {
-        qDebug() << "warning: trying to clear char out of bounds";
+    QHash<QString, uint>::const_iterator i = iClusterIndex.constFind(text);
+    if(i != iClusterIndex.constEnd())
+        return i.value();
+
+    // clusters are only dropped on reset, past the limit the combining
+    // characters are lost instead
+    if(iClusters.size() >= maxClusters)
+        return text.toUcs4().value(0, ' ');
+
+    const uint c = clusterBase + iClusters.size();
+    iClusters.append(text);
+    iClusterIndex.insert(text, c);
+    return c;
+}
+
+uint Terminal::baseCodepoint(uint c) const
+{
+    if(c < clusterBase)
+        return c;
+
+    const QString &text = cluster(c);
+    if(text.size() > 1 && text.at(0).isHighSurrogate())
+        return QChar::surrogateToUcs4(text.at(0), text.at(1));
+    return text.at(0).unicode();
+}
+
+QString Terminal::cellText(uint c) const
+{
+    if(c >= clusterBase)
+        return cluster(c);
+    return QString::fromUcs4(&c, 1);
+}
+
+void Terminal::appendPrintable(QString& text, const TermChar& ch)
+{
+    if(ch.attrib & attribWideTail)
         return;
+    if(ch.c >= clusterBase || QChar::isPrint(ch.c))
+        text += cellText(ch.c);
+}
+
+TermChar Terminal::eraseChar() const
+{
+    TermChar ch = zeroChar;
+    ch.fgColor = iTermAttribs.currentFgColor;
+    ch.bgColor = iTermAttribs.currentBgColor;
+    ch.attrib = iTermAttribs.currentAttrib;
+    return ch;
+}
+
+void Terminal::splitWideChar(QList<TermChar>& line, int column)
+{
+    // a wide character cut in half by an edit is blanked as a whole
+    if(column > 0 && column < line.size() && (line.at(column).attrib & attribWideTail)) {
+        line[column-1].c = ' ';
+        line[column].c = ' ';
+        line[column].attrib &= ~attribWideTail;
     }
+}
 
-    // just in case...
-    while(buffer().size() < pos.y())
-        buffer().append(QList<TermChar>());
-    while(buffer()[pos.y()-1].size() < pos.x() )
-        buffer()[pos.y()-1].append(zeroChar);
+void Terminal::insertBlanks(int count)
+{
+    const int x = cursorPos().x()-1;
+    int right = iTermSize.width();
+    if(hasColumnMargins()) {
+        if(!insideColumnMargins(x+1))
+            return;
+        right = iMarginRight;
+    }
+    if(x >= right)
+        return;
+    count = qMin(count, right-x);
+
+    QList<TermChar> &line = currentLine();
+    while(line.size() < right)
+        line.append(zeroChar);
+    splitWideChar(line, x);
+    splitWideChar(line, right);
+    splitWideChar(line, right-count);
+
+    for(int i=right-1; i>=x+count; i--)
+        line[i] = line.at(i-count);
+    const TermChar blank = eraseChar();
+    for(int i=x; i<x+count; i++)
+        line[i] = blank;
+}
 
-    buffer()[pos.y()-1][pos.x()-1].c = ' ';
-    buffer()[pos.y()-1][pos.x()-1].fgColor = iTermAttribs.currentFgColor;
-    buffer()[pos.y()-1][pos.x()-1].bgColor = iTermAttribs.currentBgColor;
-    buffer()[pos.y()-1][pos.x()-1].attrib = iTermAttribs.currentAttrib;
+void Terminal::deleteChars(int count)
+{
+    const int x = cursorPos().x()-1;
+    int right = iTermSize.width();
+    if(hasColumnMargins()) {
+        if(!insideColumnMargins(x+1))
+            return;
+        right = iMarginRight;
+    }
+    if(x >= right)
+        return;
+    count = qMin(count, right-x);
+
+    QList<TermChar> &line = currentLine();
+    while(line.size() < right)
+        line.append(zeroChar);
+    splitWideChar(line, x);
+    splitWideChar(line, x+count);
+    splitWideChar(line, right);
+
+    for(int i=x; i<right-count; i++)
+        line[i] = line.at(i+count);
+    const TermChar blank = eraseChar();
+    for(int i=right-count; i<right; i++)
+        line[i] = blank;
+}
+
+void Terminal::scrollColumns(int lines, int top)
+{
+    // scrolls rows top..iMarginBottom between the left and right margins,
+    // up for positive line counts; nothing goes to the scrollback
+    QList<QList<TermChar> > &buf = buffer();
+    while(buf.size() < iMarginBottom)
+        buf.append(QList<TermChar>());
+
+    const int left = iMarginLeft-1;
+    const int right = iMarginRight-1;
+    const int rows = iMarginBottom-top+1;
+    const int n = qMin(qAbs(lines), rows);
+    if(rows <= 0)
+        return;
+
+    for(int i=top-1; i<iMarginBottom; i++) {
+        QList<TermChar> &line = buf[i];
+        while(line.size() <= right)
+            line.append(zeroChar);
+        splitWideChar(line, left);
+        splitWideChar(line, right+1);
+    }
+
+    const TermChar blank = eraseChar();
+    for(int i=0; i<rows; i++) {
+        // walk away from the edge the content moves towards
+        const int row = lines > 0 ? top-1+i : iMarginBottom-1-i;
+        QList<TermChar> &line = buf[row];
+        if(i < rows-n) {
+            const QList<TermChar> &source = buf.at(lines > 0 ? row+n : row-n);
+            for(int x=left; x<=right; x++)
+                line[x] = source.at(x);
+        } else {
+            for(int x=left; x<=right; x++)
+                line[x] = blank;
+        }
+    }
+}
+
+QRect Terminal::rectFromParams(const QList<int>& params, int first)
+{
+    // top;left;bottom;right, 1-based and relative to the margins in origin
+    // mode; returns 0-based screen coordinates
+    int top = params.value(first, 0);
+    int left = params.value(first+1, 0);
+    int bottom = params.value(first+2, 0);
+    int right = params.value(first+3, 0);
+    if(top < 1)
+        top = 1;
+    if(left < 1)
+        left = 1;
+    if(bottom < 1)
+        bottom = iTermSize.height();
+    if(right < 1)
+        right = iTermSize.width();
+
+    QRect screen(0, 0, iTermSize.width(), iTermSize.height());
+    if(iTermAttribs.originMode) {
+        screen = QRect(QPoint(iMarginLeft-1, iMarginTop-1), QPoint(iMarginRight-1, iMarginBottom-1));
+        top += iMarginTop-1;
+        bottom += iMarginTop-1;
+        left += iMarginLeft-1;
+        right += iMarginLeft-1;
+    }
+    return QRect(QPoint(left-1, top-1), QPoint(right-1, bottom-1)) & screen;
+}
+
+void Terminal::fillRect(const QRect& rect, const TermChar& ch)
+{
+    if(rect.isEmpty())
+        return;
+
+    QList<QList<TermChar> > &buf = buffer();
+    while(buf.size() <= rect.bottom())
+        buf.append(QList<TermChar>());
+
+    for(int y=rect.top(); y<=rect.bottom(); y++) {
+        QList<TermChar> &line = buf[y];
+        while(line.size() <= rect.right())
+            line.append(zeroChar);
+        splitWideChar(line, rect.left());
+        splitWideChar(line, rect.right()+1);
+        for(int x=rect.left(); x<=rect.right(); x++)
+            line[x] = ch;
+    }
+}
+
+void Terminal::copyRect(const QRect& source, QPoint dest)
+{
+    const QRect target = QRect(dest, source.size()) & QRect(0, 0, iTermSize.width(), iTermSize.height());
+    if(source.isEmpty() || target.isEmpty())
+        return;
+
+    QList<QList<TermChar> > &buf = buffer();
+    while(buf.size() < iTermSize.height())
+        buf.append(QList<TermChar>());
+
+    // source and target may overlap, so take the cells out first
+    QList<QList<TermChar> > rows;
+    for(int y=0; y<target.height(); y++) {
+        QList<TermChar> cells = buf.at(source.top()+y).mid(source.left(), target.width());
+        while(cells.size() < target.width())
+            cells.append(zeroChar);
+        // keep only whole wide characters
+        if(cells.first().attrib & attribWideTail) {
+            cells.first().c = ' ';
+            cells.first().attrib &= ~attribWideTail;
+        }
+        const int after = source.left()+target.width();
+        if(after < buf.at(source.top()+y).size() && (buf.at(source.top()+y).at(after).attrib & attribWideTail))
+            cells.last().c = ' ';
+        for(int x=0; x<cells.size(); x++)
+            cells[x].attrib &= ~attribWrapped;
+        rows.append(cells);
+    }
+
+    for(int y=0; y<target.height(); y++) {
+        QList<TermChar> &line = buf[target.top()+y];
+        while(line.size() <= target.right())
+            line.append(zeroChar);
+        splitWideChar(line, target.left());
+        splitWideChar(line, target.right()+1);
+        for(int x=0; x<target.width(); x++)
+            line[target.left()+x] = rows.at(y).at(x);
+    }
 }
 
 void Terminal::eraseLineAtCursor(int from, int to)
@@ -465,6 +915,8 @@ void Terminal::eraseLineAtCursor(int from, int to)
 
     while(curLine.size() <= to)
         curLine.append(zeroChar);
+    splitWideChar(curLine, from);
+    splitWideChar(curLine, to+1);
 
     for(int i=from; i<=to; i++) {
         curLine[i].c = ' ';
@@ -500,24 +952,37 @@ void Terminal::clearAll(bool wholeBuffer)
 
 void Terminal::ansiSequence(const QString& seq)
 {
+    TRACE_SCOPE("Terminal::ansiSequence");
+
     if(seq.length() <= 1 || seq.at(0)!='[')
         return;
+    iStats.sequences++;
 
     QChar cmdChar = seq.at(seq.length()-1);
     QString extra;
+    QString intermediate;
     QList<int> params;
 
     int x=1;
     while(x<seq.length()-1 && !QChar(seq.at(x)).isNumber())
         x++;
 
-    QList<QString> tmp = seq.mid(x,seq.length()-x-1).split(';');
+    // intermediate bytes (0x20-0x2F) between the parameters and the final byte
+    int end = seq.length()-1;
+    while(end>x && seq.at(end-1).unicode() >= 0x20 && seq.at(end-1).unicode() <= 0x2F)
+        end--;
+    intermediate = seq.mid(end, seq.length()-1-end);
+
+    QList<QString> tmp = seq.mid(x,end-x).split(';');
     foreach(QString b, tmp) {
         bool ok=false;
         int t = b.toInt(&ok);
         if(ok) {
             params.append(t);
         }
+        else if(b.isEmpty() && tmp.count() > 1) {  // omitted, keeps the position of the ones after it
+            params.append(0);
+        }
     }
     if(x>1)
         extra = seq.mid(1,x-1);
@@ -612,7 +1077,7 @@ void Terminal::ansiSequence(const QString& seq)
         while(params.count()<2)
             params.append(1);
         if (iTermAttribs.originMode)
-            setCursorPos(QPoint( params.at(1), params.at(0)+iMarginTop-1 ));
+            setCursorPos(QPoint( params.at(1)+iMarginLeft-1, params.at(0)+iMarginTop-1 ));
         else
             setCursorPos(QPoint( params.at(1), params.at(0) ));
         break;
@@ -683,6 +1148,8 @@ void Terminal::ansiSequence(const QString& seq)
         }
         if(cursorPos().y() < iMarginTop || cursorPos().y() > iMarginBottom)
             break;
+        if(hasColumnMargins() && !insideColumnMargins(cursorPos().x()))
+            break;
         if(params.count()<1)
             params.append(1);
         if(params.at(0)==0)
@@ -691,7 +1158,7 @@ void Terminal::ansiSequence(const QString& seq)
             scrollBack(iMarginBottom-cursorPos().y(), cursorPos().y());
         else
             scrollBack(params.at(0), cursorPos().y());
-        setCursorPos(QPoint(1,cursorPos().y()));
+        setCursorPos(QPoint(iMarginLeft,cursorPos().y()));
         break;
     case 'M':  // delete lines
         if(!extra.isEmpty()) {
@@ -700,6 +1167,8 @@ void Terminal::ansiSequence(const QString& seq)
         }
         if(cursorPos().y() < iMarginTop || cursorPos().y() > iMarginBottom)
             break;
+        if(hasColumnMargins() && !insideColumnMargins(cursorPos().x()))
+            break;
         if(params.count()<1)
             params.append(1);
         if(params.at(0)==0)
@@ -708,7 +1177,7 @@ void Terminal::ansiSequence(const QString& seq)
             scrollFwd(iMarginBottom-cursorPos().y(), cursorPos().y());
         else
             scrollFwd(params.at(0), cursorPos().y());
-        setCursorPos(QPoint(1,cursorPos().y()));
+        setCursorPos(QPoint(iMarginLeft,cursorPos().y()));
         break;
 
     case 'P': // delete characters
@@ -720,8 +1189,7 @@ void Terminal::ansiSequence(const QString& seq)
             params.append(1);
         if(params.at(0)==0)
             params[0]=1;
-        for(int i=0; i<params.at(0); i++)
-            deleteAt(cursorPos());
+        deleteChars(params.at(0));
         break;
     case '@': // insert blank characters
         if(!extra.isEmpty()) {
@@ -732,8 +1200,30 @@ void Terminal::ansiSequence(const QString& seq)
             params.append(1);
         if(params.at(0)==0)
             params[0] = 1;
-        for(int i=1; i<=params.at(0); i++)
-            insertAtCursor(zeroChar.c, false, false);
+        insertBlanks(params.at(0));
+        break;
+    case 'X': // erase characters
+        if(!extra.isEmpty()) {
+            unhandled=true;
+            break;
+        }
+        if(params.count()<1)
+            params.append(1);
+        if(params.at(0)==0)
+            params[0]=1;
+        eraseLineAtCursor(cursorPos().x(), cursorPos().x()+qMin(params.at(0), iTermSize.width())-1);
+        break;
+    case 'b': // repeat the preceding character
+        if(!extra.isEmpty() || iLastChar==0) {
+            unhandled=true;
+            break;
+        }
+        if(params.count()<1)
+            params.append(1);
+        if(params.at(0)==0)
+            params[0]=1;
+        for(int i=qMin(params.at(0), iTermSize.width()*iTermSize.height()); i>0; i--)
+            insertAtCursor(iLastChar, !iReplaceMode);
         break;
 
     case 'S':  // scroll up n lines
@@ -755,7 +1245,8 @@ void Terminal::ansiSequence(const QString& seq)
         if(params.count()==0)
             params.append(0);
         if(params.count()==1 && params.at(0)==0) {
-            QString toWrite = QString("%1[?1;2c").arg(ch_ESC).toLatin1();
+            // VT420 class with ANSI color and rectangular editing
+            QString toWrite = QString("%1[?64;22;28c").arg(ch_ESC).toLatin1();
             if(iPtyIFace)
                 iPtyIFace->writeTerm(toWrite);
         } else unhandled=true;
@@ -799,15 +1290,37 @@ void Terminal::ansiSequence(const QString& seq)
     case 'p':
         if(extra=="!") {  // reset terminal
             resetTerminal();
+        }
+        else if(extra=="?" && intermediate=="$" && params.count()==1) {  // DECRQM, report private mode
+            QString toWrite = QString("%1[?%2;%3$y").arg(ch_ESC).arg(params.at(0)).arg(privateModeState(params.at(0))).toLatin1();
+            if(iPtyIFace)
+                iPtyIFace->writeTerm(toWrite);
         } else unhandled=true;
         break;
 
-    case 's': //save cursor
+    case 's': //save cursor, or left and right margins (DECSLRM) when enabled
         if(!extra.isEmpty()) {
             unhandled=true;
             break;
         }
-        iTermAttribs_saved = iTermAttribs;
+        if(iColumnMarginMode) {
+            int left = params.value(0, 0);
+            int right = params.value(1, 0);
+            if(left < 1)
+                left = 1;
+            if(right < 1 || right > iTermSize.width())
+                right = iTermSize.width();
+            if(left >= right)
+                break;
+            iMarginLeft = left;
+            iMarginRight = right;
+            if(iTermAttribs.originMode)
+                setCursorPos(QPoint(iMarginLeft, iMarginTop));
+            else
+                setCursorPos(QPoint(1, 1));
+        }
+        else
+            iTermAttribs_saved = iTermAttribs;
         break;
     case 'u': //restore cursor
         if(!extra.isEmpty()) {
@@ -822,66 +1335,70 @@ void Terminal::ansiSequence(const QString& seq)
             unhandled=true;
             break;
         }
-        if(params.count() > 0) {
-            // xterm 256-colour support
-            if(params.count() > 1 && (params[0] == 38 || params[0] == 48)) {
-                if(params.count() > 2 && params[1] == 5 &&
-                   params[2] >= 0 && params[2] <= 255) {
-                    if(params[0] == 38)
-                        iTermAttribs.currentFgColor = params[2];
+        if(params.isEmpty())
+            params.append(0);
+
+        for(int i=0; i<params.count(); i++) {
+            const int p = params.at(i);
+
+            if(p == 38 || p == 48) {
+                // xterm 256 colour (5;n) and 24-bit colour (2;r;g;b)
+                int color = -1;
+                if(i+2 < params.count() && params.at(i+1) == 5) {
+                    if(params.at(i+2) >= 0 && params.at(i+2) <= 255)
+                        color = params.at(i+2);
+                    i += 2;
+                }
+                else if(i+4 < params.count() && params.at(i+1) == 2) {
+                    color = colorRgbFlag |
+                            qBound(0, params.at(i+2), 255) << 16 |
+                            qBound(0, params.at(i+3), 255) << 8 |
+                            qBound(0, params.at(i+4), 255);
+                    i += 4;
+                }
+                else {
+                    break;
+                }
+                if(color >= 0) {
+                    if(p == 38)
+                        iTermAttribs.currentFgColor = color;
                     else
-                        iTermAttribs.currentBgColor = params[2];
+                        iTermAttribs.currentBgColor = color;
                 }
-                // TODO: 2;r;g;b for 24-bit colour support (Konsole etc)
-                break;
             }
-
-            if(params.contains(0)) {
+            else if(p == 0) {
                 iTermAttribs.currentFgColor = defaultFgColor;
                 iTermAttribs.currentBgColor = defaultBgColor;
                 iTermAttribs.currentAttrib = attribNone;
             }
-            if(params.contains(1))
+            else if(p == 1)
                 iTermAttribs.currentAttrib |= attribBold;
-            if(params.contains(4))
+            else if(p == 4)
                 iTermAttribs.currentAttrib |= attribUnderline;
-            if(params.contains(7))
+            else if(p == 7)
                 iTermAttribs.currentAttrib |= attribNegative;
-
-            if(params.contains(22))
+            else if(p == 9)
+                iTermAttribs.currentAttrib |= attribStrikethrough;
+            else if(p == 22)
                 iTermAttribs.currentAttrib &= ~attribBold;
-            if(params.contains(24))
+            else if(p == 24)
                 iTermAttribs.currentAttrib &= ~attribUnderline;
-            if(params.contains(27))
+            else if(p == 27)
                 iTermAttribs.currentAttrib &= ~attribNegative;
-
-            foreach(int p, params) {
-                if(p >= 30 && p<= 37) {
-                    iTermAttribs.currentFgColor = p-30;
-                }
-                if(p >= 40 && p<= 47) {
-                    iTermAttribs.currentBgColor = p-40;
-                }
-            }
-
-            // high-intensity regular-weight extension (nonstandard)
-            foreach(int p, params) {
-                if(p >= 90 && p<= 97) {
-                    iTermAttribs.currentFgColor = p-90+8;
-                }
-                if(p >= 100 && p<= 107) {
-                    iTermAttribs.currentBgColor = p-100+8;
-                }
-            }
-
-            if(params.contains(39))
+            else if(p == 29)
+                iTermAttribs.currentAttrib &= ~attribStrikethrough;
+            else if(p >= 30 && p <= 37)
+                iTermAttribs.currentFgColor = p-30;
+            else if(p >= 40 && p <= 47)
+                iTermAttribs.currentBgColor = p-40;
+            else if(p >= 90 && p <= 97)  // high-intensity regular-weight extension (nonstandard)
+                iTermAttribs.currentFgColor = p-90+8;
+            else if(p >= 100 && p <= 107)
+                iTermAttribs.currentBgColor = p-100+8;
+            else if(p == 39)
                 iTermAttribs.currentFgColor = defaultFgColor;
-            if(params.contains(49))
+            else if(p == 49)
                 iTermAttribs.currentBgColor = defaultBgColor;
-        } else {
-            iTermAttribs.currentFgColor = defaultFgColor;
-            iTermAttribs.currentBgColor = defaultBgColor;
-            iTermAttribs.currentAttrib = attribNone;
         }
         break;
 
@@ -895,6 +1412,8 @@ void Terminal::ansiSequence(const QString& seq)
             resetTabs();
             iMarginTop = 1;
             iMarginBottom = iTermSize.height();
+            iMarginLeft = 1;
+            iMarginRight = iTermSize.width();
         }
         else if(params.count()>=1 && params.contains(6) && extra=="?") { //origin mode enable
             iTermAttribs.originMode = true;
@@ -917,7 +1436,16 @@ void Terminal::ansiSequence(const QString& seq)
 
             clearAll();
             resetTabs();
-            emit displayBufferChanged();
+            bufferChanged();
+        }
+        else if(params.count()>=1 && params.contains(69) && extra=="?") { // enable left and right margins
+            iColumnMarginMode = true;
+        }
+        else if(params.count()>=1 && params.contains(2026) && extra=="?") { // begin synchronized update
+            beginSyncUpdate();
+        }
+        else if(params.count()>=1 && params.contains(performanceHudMode) && extra=="?") {
+            emit performanceHudRequested(true);
         }
         else if(params.count()>=1 && params.contains(4) && extra=="") {
             iReplaceMode = true;
@@ -938,6 +1466,8 @@ void Terminal::ansiSequence(const QString& seq)
             resetTabs();
             iMarginTop = 1;
             iMarginBottom = iTermSize.height();
+            iMarginLeft = 1;
+            iMarginRight = iTermSize.width();
         }
         else if(params.count()>=1 && params.contains(6) && extra=="?") { //origin mode disable
             iTermAttribs.originMode = false;
@@ -958,9 +1488,20 @@ void Terminal::ansiSequence(const QString& seq)
             iMarginTop = 1;
             resetBackBufferScrollPos();
             resetTabs();
-            emit displayBufferChanged();
+            bufferChanged();
         }
 
+        else if(params.count()>=1 && params.contains(69) && extra=="?") { // disable left and right margins
+            iColumnMarginMode = false;
+            iMarginLeft = 1;
+            iMarginRight = iTermSize.width();
+        }
+        else if(params.count()>=1 && params.contains(2026) && extra=="?") { // end synchronized update
+            endSyncUpdate();
+        }
+        else if(params.count()>=1 && params.contains(performanceHudMode) && extra=="?") {
+            emit performanceHudRequested(false);
+        }
         else if(params.count()>=1 && params.contains(4) && extra=="") {
             iReplaceMode = false;
         }
@@ -970,6 +1511,41 @@ void Terminal::ansiSequence(const QString& seq)
         else unhandled=true;
         break;
 
+    case 'x': // fill rectangular area (DECFRA)
+        if(!extra.isEmpty() || intermediate!="$" || params.count()<1) {
+            unhandled=true;
+            break;
+        }
+        if((params.at(0) >= 32 && params.at(0) <= 126) || (params.at(0) >= 160 && params.at(0) <= 255)) {
+            TermChar ch = eraseChar();
+            ch.c = params.at(0);
+            fillRect(rectFromParams(params, 1), ch);
+        }
+        break;
+    case 'z': // erase rectangular area (DECERA)
+        if(!extra.isEmpty() || intermediate!="$") {
+            unhandled=true;
+            break;
+        }
+        fillRect(rectFromParams(params, 0), eraseChar());
+        break;
+    case 'v': // copy rectangular area (DECCRA), pages are ignored
+        if(!extra.isEmpty() || intermediate!="$") {
+            unhandled=true;
+            break;
+        }
+        {
+            const QRect source = rectFromParams(params, 0);
+            int top = qMax(1, params.value(5, 1));
+            int left = qMax(1, params.value(6, 1));
+            if(iTermAttribs.originMode) {
+                top += iMarginTop-1;
+                left += iMarginLeft-1;
+            }
+            copyRect(source, QPoint(left-1, top-1));
+        }
+        break;
+
     case 'r':  // scrolling region
         if(!extra.isEmpty()) {
             unhandled=true;
@@ -1007,31 +1583,137 @@ void Terminal::ansiSequence(const QString& seq)
         qDebug() << "unhandled ansi sequence " << cmdChar << params << extra;
 }
 
-void Terminal::oscSequence(const QString& seq)
+void Terminal::resetOsc()
 {
-    if(seq.length() <= 1 || seq.at(0)!=']')
-        return;
+    iOscCommand = oscNone;
+    iOscField = 0;
+    oscSeq.clear();
+    iOscData.clear();
+    iOscBase64.clear();
+}
 
-    // set window title
-    if( seq.length() >= 3 && seq.at(0)==']' &&
-        (seq.at(1)=='0' || seq.at(1)=='2') &&
-        seq.at(2)==';' )
-    {
-        iUtil->setWindowTitle(seq.mid(3));
+void Terminal::oscChar(QChar ch)
+{
+    // OSC payloads are handled as they stream in: only the parts that are
+    // used are kept, each with a cap, and the rest is skipped
+    if(iOscCommand == oscPrefix) {
+        if(ch == ';') {
+            bool ok = false;
+            iOscCommand = oscSeq.toInt(&ok);
+            if(!ok || iOscCommand < 0) {
+                qDebug() << "unhandled OSC" << oscSeq;
+                iOscCommand = oscDiscard;
+            }
+            oscSeq.clear();
+        }
+        else if(oscSeq.length() < maxOscPrefix)
+            oscSeq += ch;
+        else
+            iOscCommand = oscDiscard;
         return;
     }
 
-    qDebug() << "unhandled OSC" << seq;
+    switch(iOscCommand) {
+    case 0:  // icon name and window title
+    case 2:  // window title
+        if(oscSeq.length() < maxTitleLength)
+            oscSeq += ch;
+        break;
+    case 8:  // hyperlink, params;URI
+        if(iOscField == 0) {
+            if(ch == ';')
+                iOscField++;
+        }
+        else if(oscSeq.length() < maxHyperlinkLength)
+            oscSeq += ch;
+        else
+            iOscCommand = oscDiscard;
+        break;
+    case 52:  // clipboard, selections;base64 data
+        if(iOscField == 0) {
+            if(ch == ';')
+                iOscField++;
+        }
+        else if((ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') || (ch >= '0' && ch <= '9') ||
+                ch == '+' || ch == '/' || ch == '=') {
+            iOscBase64 += ch.toLatin1();
+            if(iOscBase64.size() >= 4096)
+                decodeOscData();
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void Terminal::decodeOscData()
+{
+    // decodes complete groups of four, a partial one waits for more data
+    const int length = iOscBase64.size() & ~3;
+    iOscData += QByteArray::fromBase64(iOscBase64.left(length));
+    iOscBase64.remove(0, length);
+
+    if(iOscData.size() > maxClipboardBytes) {
+        qDebug() << "OSC 52 data too large, discarding";
+        iOscCommand = oscDiscard;
+        iOscData.clear();
+        iOscBase64.clear();
+    }
+}
+
+void Terminal::finishOsc()
+{
+    if(iOscCommand != oscNone)
+        iStats.sequences++;
+
+    switch(iOscCommand) {
+    case oscNone:
+    case oscDiscard:
+        break;
+    case oscPrefix:
+        qDebug() << "unhandled OSC" << oscSeq;
+        break;
+    case 0:
+    case 2:
+        emit windowTitleChanged(oscSeq);
+        break;
+    case 8:
+        // the links are offered with the URLs grabbed from the screen,
+        // "8;;" just ends the linked text
+        if(!oscSeq.isEmpty()) {
+            iHyperlinks.removeAll(oscSeq);
+            iHyperlinks.append(oscSeq);
+            if(iHyperlinks.size() > maxHyperlinks)
+                iHyperlinks.removeFirst();
+        }
+        break;
+    case 52:
+        decodeOscData();
+        if(!iOscData.isEmpty() && iClipboard && iSettings &&
+                iSettings->settingsValue("terminal/allowClipboardWrite").toBool())
+            iClipboard->setClipboardText(QString::fromUtf8(iOscData));
+        break;
+    default:
+        qDebug() << "unhandled OSC" << iOscCommand;
+        break;
+    }
+    resetOsc();
 }
 
 void Terminal::escControlChar(const QString& seq)
 {
     QChar ch;
+    iStats.sequences++;
 
     if(seq.length()==1) {
         ch = seq.at(0);
     } else if (seq.length()>1 ){ // control sequences longer than 1 characters
-        if( seq.at(0) == '(' || seq.at(0)==')' ) // character set, ignore this for now...
+        const int designate = QString("()*+").indexOf(seq.at(0));
+        if( designate >= 0 ) { // character set to G0-G3
+            iTermAttribs.charsets[designate] = charsetTable(seq.at(1));
+            return;
+        }
+        if( seq.at(0) == '-' || seq.at(0) == '.' || seq.at(0) == '/' ) // 96 character sets, for GR only
             return;
         if( seq.at(0) == '#' && seq.at(1)=='8' ) { // test mode, fill screen with 'E'
             clearAll(true);
@@ -1084,8 +1766,15 @@ void Terminal::escControlChar(const QString& seq)
     else if(latin=='c') {  // full reset
         resetTerminal();
     }
+    else if(latin=='N' || latin=='O') {  // SS2, SS3: G2 or G3 for the next character
+        iSingleShift = latin=='N' ? 2 : 3;
+    }
+    else if(latin=='n' || latin=='o') {  // LS2, LS3: G2 or G3 into GL
+        iTermAttribs.glCharset = latin=='n' ? 2 : 3;
+    }
     else if(latin=='g') {  // visual bell
-        iUtil->bellAlert();
+        if(iBell)
+            iBell->bellAlert();
     }
     else {
         qDebug() << "unhandled escape code ESC" << seq;
@@ -1118,8 +1807,7 @@ const QStringList Terminal::printableLinesFromCursor(int lines, bool withEmptyLi
         ret.append("");
         if(l >= 0 && l < buffer().size()) {
             for(int i=0; i<buffer()[l].size(); i++) {
-                if(buffer()[l][i].c.isPrint())
-                    ret[ret.size()-1].append(buffer()[l][i].c);
+                appendPrintable(ret[ret.size()-1], buffer()[l][i]);
             }
         }
     }
@@ -1129,15 +1817,20 @@ const QStringList Terminal::printableLinesFromCursor(int lines, bool withEmptyLi
 
 void Terminal::trimBackBuffer()
 {
-    while(backBuffer().size() > maxScrollBackLines) {
+    while(backBuffer().size() > maxScrollBackLines)
         backBuffer().removeFirst();
-    }
 }
 
 void Terminal::scrollBack(int lines, int insertAt)
 {
     if(lines <= 0)
         return;
+    iStats.scrolledLines += lines;
+
+    if(hasColumnMargins()) {
+        scrollColumns(-lines, insertAt==-1 ? iMarginTop : insertAt);
+        return;
+    }
 
     adjustSelectionPosition(lines);
 
@@ -1170,8 +1863,16 @@ void Terminal::scrollBack(int lines, int insertAt)
 
 void Terminal::scrollFwd(int lines, int removeAt)
 {
+    TRACE_SCOPE("Terminal::scrollFwd");
+
     if(lines <= 0)
         return;
+    iStats.scrolledLines += lines;
+
+    if(hasColumnMargins()) {
+        scrollColumns(lines, removeAt==-1 ? iMarginTop : removeAt);
+        return;
+    }
 
     adjustSelectionPosition(-lines);
 
@@ -1201,6 +1902,11 @@ void Terminal::resetTerminal()
     iBuffer.clear();
     iAltBuffer.clear();
     iBackBuffer.clear();
+    iClusters.clear();
+    iClusterIndex.clear();
+    iHyperlinks.clear();
+    iSyncUpdate = false;
+    iSyncTimer.stop();
 
     iTermAttribs.currentFgColor = defaultFgColor;
     iTermAttribs.currentBgColor = defaultBgColor;
@@ -1208,12 +1914,19 @@ void Terminal::resetTerminal()
     iTermAttribs.cursorPos = QPoint(1,1);
     iTermAttribs.wrapAroundMode = true;
     iTermAttribs.originMode = false;
+    resetCharsets();
 
     iTermAttribs_saved = iTermAttribs;
     iTermAttribs_saved_alt = iTermAttribs;
 
     iMarginBottom = iTermSize.height();
     iMarginTop = 1;
+    iMarginLeft = 1;
+    iMarginRight = iTermSize.width();
+    iColumnMarginMode = false;
+    iMarginWrapPending = false;
+    iLastChar = 0;
+    iPendingJoiner = false;
 
     iShowCursor = true;
     iUseAltScreenBuffer = false;
@@ -1227,6 +1940,26 @@ void Terminal::resetTerminal()
     clearSelection();
 }
 
+void Terminal::resetCharsets()
+{
+    for(int i=0; i<4; i++)
+        iTermAttribs.charsets[i] = 0;
+    iTermAttribs.glCharset = 0;
+    iSingleShift = -1;
+}
+
+const uint* Terminal::charsetTable(QChar designation)
+{
+    switch(designation.toLatin1()) {
+    case '0':  // DEC special graphics
+        return charsetTables.decGraphics;
+    case 'A':  // British
+        return charsetTables.british;
+    default:   // ASCII and the national sets we do not have
+        return 0;
+    }
+}
+
 void Terminal::resetTabs()
 {
     iTabStops.clear();
@@ -1240,32 +1973,157 @@ void Terminal::resetTabs()
     }
 }
 
+void Terminal::reflowScreen(QSize newSize)
+{
+    // The alternate screen belongs to a full screen program that redraws
+    // itself on SIGWINCH, only the normal screen and the scrollback are
+    // rewrapped.
+    QPoint &cursor = iUseAltScreenBuffer ? iTermAttribs_saved_alt.cursorPos : iTermAttribs.cursorPos;
+    const int width = newSize.width();
+
+    clearSelection();
+    resetBackBufferScrollPos();
+
+    // the rows at the end of the scrollback that continue on the screen
+    // are rewrapped together with it
+    QList<QList<TermChar> > rows;
+    while(!iBackBuffer.isEmpty() && isWrapped(iBackBuffer.last()))
+        rows.prepend(iBackBuffer.takeLast());
+    const int cursorRow = rows.size() + cursor.y() - 1;
+
+    // blank rows below the cursor need no rewrapping
+    int used = 0;
+    for(int i=0; i<iBuffer.size(); i++) {
+        if(!iBuffer.at(i).isEmpty())
+            used = i+1;
+    }
+    rows.append(iBuffer.mid(0, qMax(used, cursor.y())));
+    while(rows.size() <= cursorRow)
+        rows.append(QList<TermChar>());
+
+    QList<QList<TermChar> > screen;
+    int newCursorRow = 0;
+    int newCursorCol = 1;
+    int lineStart = 0;
+    for(int i=0; i<rows.size(); i++) {
+        if(isWrapped(rows.at(i)) && i<rows.size()-1)
+            continue;
+
+        int cursorOffset = -1;
+        if(cursorRow >= lineStart && cursorRow <= i) {
+            for(int j=lineStart; j<cursorRow; j++)
+                cursorOffset += rows.at(j).size();
+            cursorOffset += cursor.x();
+        }
+
+        const QList<TermChar> line = joinRows(rows, lineStart, i+1, cursorOffset);
+        if(cursorOffset >= 0) {
+            // a cursor just past a full last row stays there, waiting for the
+            // next character to wrap
+            if(cursorOffset > 0 && cursorOffset % width == 0 && cursorOffset >= line.size()) {
+                newCursorRow = screen.size() + cursorOffset/width - 1;
+                newCursorCol = width+1;
+            } else {
+                newCursorRow = screen.size() + cursorOffset/width;
+                newCursorCol = cursorOffset%width + 1;
+            }
+        }
+        wrapLine(line, width, screen);
+        lineStart = i+1;
+    }
+
+    // keep the cursor on the screen, the rows pushed out of it go to the
+    // scrollback
+    int excess = qMax(0, screen.size() - newSize.height());
+    excess = qMax(excess, newCursorRow - newSize.height() + 1);
+    excess = qMin(excess, newCursorRow);
+
+    // the scrollback is at most maxScrollBackLines rows, cheap enough to
+    // rewrap at once
+    QList<QList<TermChar> > history;
+    lineStart = 0;
+    for(int i=0; i<iBackBuffer.size(); i++) {
+        if(isWrapped(iBackBuffer.at(i)) && i<iBackBuffer.size()-1)
+            continue;
+        wrapLine(joinRows(iBackBuffer, lineStart, i+1), width, history);
+        lineStart = i+1;
+    }
+    iBackBuffer = history + screen.mid(0, excess);
+    iBuffer = screen.mid(excess, newSize.height());
+    while(iBuffer.size() < newSize.height())
+        iBuffer.append(QList<TermChar>());
+    trimBackBuffer();
+
+    cursor = QPoint(newCursorCol, newCursorRow - excess + 1);
+}
+
+QList<TermChar> Terminal::joinRows(const QList<QList<TermChar> >& rows, int from, int to, int minLength)
+{
+    QList<TermChar> line;
+    for(int i=from; i<to; i++) {
+        line.append(rows.at(i));
+        if(!line.isEmpty())
+            line.last().attrib &= ~attribWrapped;
+    }
+
+    // the blank cells at the end were never written, or were erased
+    while(line.size() > minLength && line.last().c == ' ' &&
+          line.last().bgColor == defaultBgColor && line.last().attrib == 0)
+        line.removeLast();
+
+    while(line.size() < minLength)
+        line.append(zeroChar);
+
+    return line;
+}
+
+void Terminal::wrapLine(const QList<TermChar>& line, int width, QList<QList<TermChar> >& out)
+{
+    if(line.isEmpty()) {
+        out.append(QList<TermChar>());
+        return;
+    }
+
+    for(int pos=0; pos<line.size(); ) {
+        // a wide character is not split between rows
+        int length = width;
+        if(width > 1 && pos+length < line.size() && (line.at(pos+length).attrib & attribWideTail))
+            length--;
+        out.append(line.mid(pos, length));
+        pos += length;
+        if(pos < line.size())
+            out.last().last().attrib |= attribWrapped;
+    }
+}
+
 void Terminal::pasteFromClipboard()
 {
-    QClipboard *cb = QGuiApplication::clipboard();
+    if(!iClipboard)
+        return;
 
-    if(iPtyIFace && !cb->text().isEmpty()) {
+    const QString text = iClipboard->clipboardText();
+    if(iPtyIFace && !text.isEmpty()) {
         resetBackBufferScrollPos();
-        iPtyIFace->writeTerm(cb->text());
+        iPtyIFace->writeTerm(text);
     }
 }
 
 const QStringList Terminal::grabURLsFromBuffer()
 {
     QStringList ret;
-    QByteArray buf;
+    QString buf;
 
     //backbuffer
-    if ((iUtil->settingsValue("gen/grabUrlsFromBackbuffer").toBool()
+    if ((iSettings && iSettings->settingsValue("gen/grabUrlsFromBackbuffer").toBool()
          && !iUseAltScreenBuffer)
         || backBufferScrollPos() > 0)  //a lazy workaround: just grab everything when the buffer is being scrolled (TODO: make a proper fix)
     {
         for (int i=0; i<iBackBuffer.size(); i++) {
             for (int j=0; j<iBackBuffer[i].size(); j++) {
-                if (iBackBuffer[i][j].c.isPrint())
-                    buf.append(iBackBuffer[i][j].c);
-                else if (iBackBuffer[i][j].c == 0)
+                if (iBackBuffer[i][j].c == 0)
                     buf.append(' ');
+                else
+                    appendPrintable(buf, iBackBuffer[i][j]);
             }
             if (iBackBuffer[i].size() < iTermSize.width())
                 buf.append(' ');
@@ -1275,10 +2133,10 @@ const QStringList Terminal::grabURLsFromBuffer()
     //main buffer
     for (int i=0; i<buffer().size(); i++) {
         for (int j=0; j<buffer()[i].size(); j++) {
-            if (buffer()[i][j].c.isPrint())
-                buf.append(buffer()[i][j].c);
-            else if (buffer()[i][j].c == 0)
+            if (buffer()[i][j].c == 0)
                 buf.append(' ');
+            else
+                appendPrintable(buf, buffer()[i][j]);
         }
         if (buffer()[i].size() < iTermSize.width())
             buf.append(' ');
@@ -1307,6 +2165,7 @@ const QStringList Terminal::grabURLsFromBuffer()
         QString word = match.captured(1);
         ret << word;
     }
+    ret << iHyperlinks;
 
     ret.removeDuplicates();
     return ret;
@@ -1314,11 +2173,11 @@ const QStringList Terminal::grabURLsFromBuffer()
 
 QString Terminal::getUserMenuXml()
 {
-    if(!iUtil)
+    if(!iSettings)
         return QString();
 
     QString ret;
-    QFile f( iUtil->configPath()+"/menu.xml" );
+    QFile f( iSettings->configPath()+"/menu.xml" );
     if(f.open(QIODevice::ReadOnly|QIODevice::Text)) {
         ret = f.readAll();
         f.close();
@@ -1338,10 +2197,7 @@ void Terminal::scrollBackBufferFwd(int lines)
     if(iBackBufferScrollPos < 0)
         iBackBufferScrollPos = 0;
 
-    if (iRenderer) {
-        iRenderer->setShowBufferScrollIndicator(iBackBufferScrollPos != 0);
-        iRenderer->redraw();
-    }
+    emit backBufferScrollPosChanged();
 }
 
 void Terminal::scrollBackBufferBack(int lines)
@@ -1355,10 +2211,7 @@ void Terminal::scrollBackBufferBack(int lines)
     if (iBackBufferScrollPos > iBackBuffer.size())
         iBackBufferScrollPos = iBackBuffer.size();
 
-    if (iRenderer) {
-        iRenderer->setShowBufferScrollIndicator(iBackBufferScrollPos != 0);
-        iRenderer->redraw();
-    }
+    emit backBufferScrollPosChanged();
 }
 
 void Terminal::resetBackBufferScrollPos()
@@ -1369,10 +2222,7 @@ void Terminal::resetBackBufferScrollPos()
     iBackBufferScrollPos = 0;
     clearSelection();
 
-    if (iRenderer) {
-        iRenderer->setShowBufferScrollIndicator(false);
-        iRenderer->redraw();
-    }
+    emit backBufferScrollPosChanged();
 }
 
 void Terminal::copySelectionToClipboard()
@@ -1380,8 +2230,8 @@ void Terminal::copySelectionToClipboard()
     if (selection().isNull())
         return;
 
-    QClipboard *cb = QGuiApplication::clipboard();
-    cb->clear();
+    if (!iClipboard)
+        return;
 
     QString text;
     QString line;
@@ -1403,8 +2253,8 @@ void Terminal::copySelectionToClipboard()
                     end = selection().right()-1;
                 }
                 for (int j=start; j<=end; j++) {
-                    if (j >= 0 && j < iBackBuffer[i].size() && iBackBuffer[i][j].c.isPrint())
-                        line += iBackBuffer[i][j].c;
+                    if (j >= 0 && j < iBackBuffer[i].size())
+                        appendPrintable(line, iBackBuffer[i][j]);
                 }
                 text += line.trimmed() + "\n";
             }
@@ -1426,8 +2276,8 @@ void Terminal::copySelectionToClipboard()
                 end = selection().right()-1;
             }
             for (int j=start; j<=end; j++) {
-                if (j >= 0 && j < buffer()[i].size() && buffer()[i][j].c.isPrint())
-                    line += buffer()[i][j].c;
+                if (j >= 0 && j < buffer()[i].size())
+                    appendPrintable(line, buffer()[i][j]);
             }
             text += line.trimmed() + "\n";
         }
@@ -1435,7 +2285,7 @@ void Terminal::copySelectionToClipboard()
 
     //qDebug() << text.trimmed();
 
-    cb->setText(text.trimmed());
+    iClipboard->setClipboardText(text.trimmed());
 }
 
 void Terminal::adjustSelectionPosition(int lines)
@@ -1465,8 +2315,7 @@ void Terminal::adjustSelectionPosition(int lines)
 
     iSelection = QRect(QPoint(tx,ty), QPoint(bx,by));
 
-    if (iRenderer)
-        iRenderer->redraw();
+    emit selectionChanged();
 }
 
 void Terminal::setSelection(QPoint start, QPoint end)
@@ -1487,8 +2336,7 @@ void Terminal::setSelection(QPoint start, QPoint end)
 
     iSelection = QRect(start, end);
 
-    if (iRenderer)
-        iRenderer->redraw();
+    emit selectionChanged();
 }
 
 void Terminal::clearSelection()
@@ -1498,10 +2346,8 @@ void Terminal::clearSelection()
 
     iSelection = QRect();
 
-    if (iUtil)
-        iUtil->selectionFinished();
-    if (iRenderer)
-        iRenderer->redraw();
+    emit selectionFinished();
+    emit selectionChanged();
 }
 
 QRect Terminal::selection()
@@ -21,15 +21,25 @@
 #define TERMINAL_H
 
 #include <QtCore>
-#include <sailfishapp.h>
 
-class TextRender;
+#include "latency.h"
+
 class PtyIFace;
-class Util;
-class QQuickView;
+class TermClipboard;
+class TermBell;
+class TermSettings;
+
+// A codepoint, or clusterBase + the index of a grapheme cluster (a base
+// character with combining marks, an emoji sequence...) in the terminal's
+// cluster pool.
+const uint clusterBase = 0x110000;
+
+// Cell colors are indexes in TextRender's palette, or 24-bit colors as
+// colorRgbFlag | 0xRRGGBB.
+const int colorRgbFlag = 0x1000000;
 
 struct TermChar {
-    QChar c;
+    uint c;
     int fgColor;
     int bgColor;
     int attrib;
@@ -39,8 +49,21 @@ const int attribNone = 0;
 const int attribBold = 1;
 const int attribUnderline = 2;
 const int attribNegative = 4;
+const int attribStrikethrough = 8;
+const int attribWrapped = 16;  // on the last cell of a row that continues on the next one
+const int attribWideTail = 32; // second cell of a double width character
+const int attribCellFlags = attribWrapped | attribWideTail;  // not part of the style
 const QByteArray multiCharEscapes("().*+-/%#");
 
+// running totals, for measuring the emulator
+struct TermStats {
+    quint64 chars;
+    quint64 sequences;
+    quint64 scrolledLines;
+    quint64 bytesRead;  // from the pty
+    quint64 reads;
+};
+
 struct TermAttribs {
     QPoint cursorPos;
 
@@ -50,6 +73,11 @@ struct TermAttribs {
     int currentFgColor;
     int currentBgColor;
     int currentAttrib;
+
+    // translation tables designated to G0-G3 (null for ASCII) and the one
+    // invoked into GL by SI/SO/LS2/LS3
+    const uint* charsets[4];
+    int glCharset;
 };
 
 class Terminal : public QObject
@@ -62,9 +90,12 @@ public:
 
     explicit Terminal(QObject *parent = 0);
     virtual ~Terminal() {}
-    void setRenderer(TextRender* tr);
     void setPtyIFace(PtyIFace* pty);
-    void setUtil(Util* util) { iUtil = util; }
+    void setClipboard(TermClipboard* clipboard) { iClipboard = clipboard; }
+    void setBell(TermBell* bell) { iBell = bell; }
+    void setSettings(TermSettings* settings) { iSettings = settings; }
+    void setBackground(bool background);
+    Q_INVOKABLE bool isBackground() { return iBackground; }
 
     void insertInBuffer(const QString& chars);
 
@@ -80,6 +111,10 @@ public:
 
     QList<TermChar>& currentLine();
 
+    const QString& cluster(uint c) const { return iClusters.at(c - clusterBase); }
+    uint baseCodepoint(uint c) const;
+    QString cellText(uint c) const;
+
     Q_INVOKABLE void keyPress(int key, int modifiers);
     Q_INVOKABLE const QStringList printableLinesFromCursor(int lines, bool withEmptyLines);
     Q_INVOKABLE void putString(QString str, bool unEscape=false);
@@ -100,45 +135,106 @@ public:
     Q_INVOKABLE void clearSelection();
     bool hasSelection();
 
+    const TermStats& stats() const { return iStats; }
+    void countRead(int bytes) { iStats.bytesRead += bytes; iStats.reads++; }
+
+    LatencyStats& latency() { return iLatency; }
+    Q_INVOKABLE void setLatencyTracking(bool enabled) { iLatency.setEnabled(enabled); }
+    Q_INVOKABLE QString latencyReport() { return iLatency.report(); }
+
     TermChar zeroChar;
 
     int defaultFgColor = 257;
     int defaultBgColor = 256;
 
+public slots:
+    void applicationStateChanged(Qt::ApplicationState state);
+
 signals:
     void cursorPosChanged(QPoint newPos);
     void termSizeChanged(QSize newSize);
     void displayBufferChanged();
+    void backBufferScrollPosChanged();
+    void selectionChanged();
+    void selectionFinished();
+    void windowTitleChanged(const QString& title);
+    void performanceHudRequested(bool show);
+
+private slots:
+    void endSyncUpdate();
+    void backgroundRefresh();
 
 private:
     Q_DISABLE_COPY(Terminal)
     static const char ch_ESC = 0x1B; //escape
     static const int maxScrollBackLines = 300;
-
-    void insertAtCursor(QChar c, bool overwriteMode=true, bool advanceCursor=true);
-    void deleteAt(QPoint pos);
-    void clearAt(QPoint pos);
+    static const int maxClusters = 0x10000;
+    static const int syncUpdateTimeout = 150;  // ms
+    static const int backgroundRefreshInterval = 1000;  // ms
+    static const int performanceHudMode = 7700;  // private mode, toeterm's own
+
+    // caps on what is kept of escape sequences
+    static const int escapeDiscard = 0x100;  // escape state while skipping a too long sequence
+    static const int maxEscSeqLength = 512;
+    static const int maxOscPrefix = 8;
+    static const int maxTitleLength = 1024;
+    static const int maxHyperlinkLength = 2048;
+    static const int maxHyperlinks = 32;
+    static const int maxClipboardBytes = 1 << 20;
+    enum { oscNone = -1, oscPrefix = -2, oscDiscard = -3 };
+
+    void insertAtCursor(uint c, bool overwriteMode=true, bool advanceCursor=true);
+    bool appendToCluster(uint c, bool afterJoinerOnly);
+    uint internCluster(const QString& text);
+    void appendPrintable(QString& text, const TermChar& ch);
+    TermChar eraseChar() const;
+    static void splitWideChar(QList<TermChar>& line, int column);
+    void insertBlanks(int count);
+    void deleteChars(int count);
+    void scrollColumns(int lines, int top);
+    QRect rectFromParams(const QList<int>& params, int first);
+    void fillRect(const QRect& rect, const TermChar& ch);
+    void copyRect(const QRect& source, QPoint dest);
+    bool hasColumnMargins() const { return iMarginLeft > 1 || iMarginRight < iTermSize.width(); }
+    bool insideColumnMargins(int x) const { return x >= iMarginLeft && x <= iMarginRight; }
     void eraseLineAtCursor(int from=-1, int to=-1);
     void clearAll(bool wholeBuffer=false);
     void ansiSequence(const QString& seq);
-    void oscSequence(const QString& seq);
+    void resetOsc();
+    void oscChar(QChar ch);
+    void decodeOscData();
+    void finishOsc();
     void escControlChar(const QString& seq);
     void trimBackBuffer();
     void scrollBack(int lines, int insertAt=-1);
     void scrollFwd(int lines, int removeAt=-1);
     void resetTerminal();
     void resetTabs();
+    void resetCharsets();
+    void bufferChanged();
+    void beginSyncUpdate();
+    int privateModeState(int mode);
+    static const uint* charsetTable(QChar designation);
     void adjustSelectionPosition(int lines);
+    void reflowScreen(QSize newSize);
+    QList<TermChar> joinRows(const QList<QList<TermChar> >& rows, int from, int to, int minLength=0);
+    void wrapLine(const QList<TermChar>& line, int width, QList<QList<TermChar> >& out);
+    static bool isWrapped(const QList<TermChar>& row) { return !row.isEmpty() && (row.last().attrib & attribWrapped); }
 
-    TextRender* iRenderer;
     PtyIFace* iPtyIFace;
-    Util* iUtil;
+    TermClipboard* iClipboard;
+    TermBell* iBell;
+    TermSettings* iSettings;
 
     QList<QList<TermChar> > iBuffer;
     QList<QList<TermChar> > iAltBuffer;
     QList<QList<TermChar> > iBackBuffer;
     QList<QList<int> > iTabStops;
 
+    // interned grapheme clusters, see TermChar
+    QVector<QString> iClusters;
+    QHash<QString, uint> iClusterIndex;
+
     QSize iTermSize;
     bool iEmitCursorChangeSignal;
 
@@ -148,9 +244,29 @@ private:
     bool iReplaceMode;
     bool iNewLineMode;
 
+    // DEC private mode 2026: the application is drawing a frame, so the
+    // screen is not repainted until it ends it or the timer runs out
+    bool iSyncUpdate;
+    QTimer iSyncTimer;
+
+    // not the active application, the screen is only seen on the cover
+    bool iBackground;
+    bool iBackgroundDirty;
+    QTimer iBackgroundTimer;
+
     int iMarginTop;
     int iMarginBottom;
 
+    // left and right margins (DECSLRM), only settable in mode 69; a cursor
+    // past the right one only wraps back to the left one if text put it there
+    bool iColumnMarginMode;
+    int iMarginLeft;
+    int iMarginRight;
+    bool iMarginWrapPending;
+
+    uint iLastChar;  // for REP
+    bool iPendingJoiner;  // a zero width joiner was the last character
+
     int iBackBufferScrollPos;
 
     TermAttribs iTermAttribs;
@@ -159,8 +275,17 @@ private:
 
     QString escSeq;
     QString oscSeq;
+    int iOscCommand;  // OSC number, or one of oscNone, oscPrefix, oscDiscard
+    int iOscField;
+    QByteArray iOscData;
+    QByteArray iOscBase64;
+    QStringList iHyperlinks;
     int escape;
+    ushort iHighSurrogate;
+    int iSingleShift;  // G2 or G3 for the next character after SS2/SS3, -1 if none
     QRect iSelection;
+    TermStats iStats;
+    LatencyStats iLatency;
 };
 
 #endif // TERMINAL_H
@@ -0,0 +1,57 @@
+/*
+    ThumbTerm Copyright Olli Vanhoja
+    FingerTerm Copyright 2011-2012 Heikki Holstila <heikki.holstila@gmail.com>
+    ToeTerm Copyright 2018 ROZZ, 2019 Matti Viljanen
+
+    This file is part of ToeTerm.
+
+    ToeTerm is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    ToeTerm is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ToeTerm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TERMINALINTERFACES_H
+#define TERMINALINTERFACES_H
+
+#include <QString>
+#include <QVariant>
+
+// What the emulator core needs from the application around it. Terminal
+// works without any of them set, which is how the tools run it. TextRender
+// takes its settings through TermSettings as well, so that it can be run
+// without the rest of the app.
+
+class TermClipboard
+{
+public:
+    virtual ~TermClipboard() {}
+    virtual QString clipboardText() = 0;
+    virtual void setClipboardText(const QString& text) = 0;
+};
+
+class TermBell
+{
+public:
+    virtual ~TermBell() {}
+    virtual void bellAlert() = 0;
+};
+
+class TermSettings
+{
+public:
+    virtual ~TermSettings() {}
+    virtual QVariant settingsValue(QString key) = 0;
+    virtual void setSettingsValue(QString key, QVariant value) = 0;
+    virtual QString configPath() = 0;
+};
+
+#endif // TERMINALINTERFACES_H
@@ -22,19 +22,35 @@
 #include <QtGui>
 #include "textrender.h"
 #include "terminal.h"
-#include "util.h"
+#include "trace.h"
 
 #include <QDebug>
 
 TextRender::TextRender(QQuickItem *parent) :
     QQuickPaintedItem(parent),
+    iCutAfter(0),
+    iShowPerformanceHud(false),
+    iHudFrames(0),
+    iHudRedraws(0),
+    iHudPaintNsecs(0),
+    iPaintBold(false),
+    iPaintFont(0),
+    iPaintFrames(0),
+    iPaintAllocations(0),
+    iPaintAllocationsReported(0),
+    iPaintDrawCalls(0),
     iTerm(0),
-    iUtil(0)
+    iSettings(0)
 {
     setFlag(ItemHasContents);
-    connect(this,SIGNAL(myWidthChanged(int)),this,SLOT(updateTermSize()));
-    connect(this,SIGNAL(myHeightChanged(int)),this,SLOT(updateTermSize()));
-    connect(this,SIGNAL(fontSizeChanged()),this,SLOT(updateTermSize()));
+    iResizeTimer.setSingleShot(true);
+    iResizeTimer.setInterval(0);
+    connect(&iResizeTimer,SIGNAL(timeout()),this,SLOT(updateTermSize()));
+    connect(this,SIGNAL(myWidthChanged(int)),this,SLOT(scheduleTermSize()));
+    connect(this,SIGNAL(myHeightChanged(int)),this,SLOT(scheduleTermSize()));
+    connect(this,SIGNAL(fontSizeChanged()),this,SLOT(scheduleTermSize()));
+    iHudTimer.setInterval(performanceHudInterval);
+    connect(&iHudTimer,SIGNAL(timeout()),this,SLOT(updatePerformanceHud()));
     iShowBufferScrollIndicator = false;
 }
 
@@ -85,6 +101,7 @@ void TextRender::loadColorScheme(QString layoutName) {
 
 void TextRender::updatePalette() {
     iColorTable.clear();
+    iRgbColors.clear();
     //normal
     iColorTable.append(qColorFromHex("paletteNormal/black"));
     iColorTable.append(qColorFromHex("paletteNormal/red"));
@@ -120,6 +137,7 @@ void TextRender::updatePalette() {
     iColorTable.append(qColorFromHex("colors/bdColor"));
     if(iColorTable.size() != 256+3)
         qFatal("invalid color table");
+    updatePaintCache();
     update();
 }
 
@@ -140,11 +158,24 @@ TextRender::~TextRender()
 
 void TextRender::paint(QPainter* painter)
 {
+    TRACE_SCOPE("TextRender::paint");
+
     if (!iTerm)
         return;
 
-    painter->save();
+    QElapsedTimer paintTimer;
+    if (iShowPerformanceHud)
+        paintTimer.start();
+
+    // the painter is created for this call only, so its state is not saved
+    // and restored (QPainter::save() allocates)
     painter->setFont(iFont);
+    iPaintBold = false;
+    iPaintFont = 0;
+    iPaintDrawCalls = 0;
+
+    if (iRgbColors.size() > maxRgbColors)
+        dropRgbColors();
 
     int y=0;
     if (iTerm->backBufferScrollPos() != 0 && iTerm->backBuffer().size()>0) {
@@ -154,34 +185,36 @@ void TextRender::paint(QPainter* painter)
         int to = iTerm->backBuffer().size();
         if(to-from > iTerm->termSize().height())
             to = from + iTerm->termSize().height();
-        paintFromBuffer(painter, iTerm->backBuffer(), from, to, y);
+        paintFromBuffer(iTerm->backBuffer(), from, to, y);
         if(to-from < iTerm->termSize().height() && iTerm->buffer().size()>0) {
             int to2 = iTerm->termSize().height() - (to-from);
             if(to2 > iTerm->buffer().size())
                 to2 = iTerm->buffer().size();
-            paintFromBuffer(painter, iTerm->buffer(), 0, to2, y);
+            paintFromBuffer(iTerm->buffer(), 0, to2, y);
         }
     } else {
         int count = qMin(iTerm->termSize().height(), iTerm->buffer().size());
-        paintFromBuffer(painter, iTerm->buffer(), 0, count, y);
+        paintFromBuffer(iTerm->buffer(), 0, count, y);
     }
+    flushBatches(painter);
 
     // cursor
     if (iTerm->showCursor()) {
         painter->setOpacity(0.5);
         QPoint cursor = cursorPixelPos();
         QSize csize = cursorPixelSize();
-        painter->setPen(Qt::transparent);
-        painter->setBrush(iColorTable[iTerm->defaultFgColor]);
+        painter->setPen(Qt::NoPen);
+        painter->setBrush(iColorBrushes.at(iTerm->defaultFgColor));
         painter->drawRect(cursor.x(), cursor.y(), csize.width(), csize.height());
+        iPaintDrawCalls++;
     }
 
     // selection
     QRect selection = iTerm->selection();
     if (!selection.isNull()) {
         painter->setOpacity(0.5);
-        painter->setPen(Qt::transparent);
-        painter->setBrush(Qt::white);
+        painter->setPen(Qt::NoPen);
+        painter->setBrush(iSelectionBrush);
         QPoint start, end;
 
         if (selection.top() == selection.bottom()) {
@@ -189,178 +222,511 @@ void TextRender::paint(QPainter* painter)
             end = charsToPixels(selection.bottomRight());
             painter->drawRect(start.x(), start.y(),
                               end.x()-start.x()+fontWidth(), end.y()-start.y()+fontHeight());
+            iPaintDrawCalls++;
         } else {
             start = charsToPixels(selection.topLeft());
             end = charsToPixels(QPoint(iTerm->termSize().width(), selection.top()));
             painter->drawRect(start.x(), start.y(),
                               end.x()-start.x()+fontWidth(), end.y()-start.y()+fontHeight());
+            iPaintDrawCalls++;
 
             start = charsToPixels(QPoint(1, selection.top()+1));
             end = charsToPixels(QPoint(iTerm->termSize().width(), selection.bottom()-1));
             painter->drawRect(start.x(), start.y(),
                               end.x()-start.x()+fontWidth(), end.y()-start.y()+fontHeight());
+            iPaintDrawCalls++;
 
             start = charsToPixels(QPoint(1, selection.bottom()));
             end = charsToPixels(selection.bottomRight());
             painter->drawRect(start.x(), start.y(),
                               end.x()-start.x()+fontWidth(), end.y()-start.y()+fontHeight());
+            iPaintDrawCalls++;
         }
     }
 
-    painter->restore();
+#ifndef QT_NO_DEBUG
+    // the scratch buffers only grow while warming up (first frames, larger
+    // screens, denser colors); report any growth after that
+    if (iPaintAllocations != iPaintAllocationsReported) {
+        if (iPaintFrames > 0)
+            qDebug() << "paint: scratch buffers grew" << iPaintAllocations-iPaintAllocationsReported << "times in frame" << iPaintFrames;
+        iPaintAllocationsReported = iPaintAllocations;
+    }
+#endif
+    iPaintFrames++;
+    iTerm->latency().painted();
+
+    if (iShowPerformanceHud) {
+        iHudFrames++;
+        iHudPaintNsecs = paintTimer.nsecsElapsed();
+        paintPerformanceHud(painter);
+    }
 }
 
-void TextRender::paintFromBuffer(QPainter* painter, QList<QList<TermChar> >& buffer, int from, int to, int &y)
+// Appends to a per-frame scratch vector. The vectors are emptied with
+// resize(0), which keeps their capacity once it has been reserved, so in
+// steady state this never allocates. Growth is counted in iPaintAllocations.
+template <typename T>
+static inline void scratchAppend(QVector<T>& v, const T& value, int& allocations)
+{
+    if (v.size() == v.capacity()) {
+        v.reserve(qMax(16, v.capacity()*2));
+        allocations++;
+    }
+    v.append(value);
+}
+
+void TextRender::paintFromBuffer(const QList<QList<TermChar> >& buffer, int from, int to, int &y)
 {
     const int leftmargin = 2;
-    int cutAfter = property("cutAfter").toInt() + iFontDescent;
+    const int cutAfter = iCutAfter + iFontDescent;
+    const int width = iTerm->termSize().width();
 
-    TermChar tmp = iTerm->zeroChar;
-    TermChar nextAttrib = iTerm->zeroChar;
-    TermChar currAttrib = iTerm->zeroChar;
-    float currentX = leftmargin;
     for(int i=from; i<to; i++) {
         y += iFontHeight;
 
-        if(y >= cutAfter)
-            painter->setOpacity(0.3);
-        else
-            painter->setOpacity(1.0);
-
-        int xcount = qMin(buffer.at(i).count(), iTerm->termSize().width());
-
-        // background for the current line
-        currentX = leftmargin;
-        int fragWidth = 0;
-        painter->setPen(Qt::transparent);
-        for(int j=0; j<xcount; j++) {
-            tmp = buffer[i][j];
-            fragWidth += iFontWidth;
-            if (j==0) {
-                currAttrib = tmp;
-                nextAttrib = tmp;
-            } else if (j<xcount-1) {
-                nextAttrib = buffer[i][j+1];
+        const bool dimmed = (y >= cutAfter);
+        const QList<TermChar> &line = buffer.at(i);
+        const int xcount = qMin(line.count(), width);
+
+        // split the line into runs of identical style, a single pass collects
+        // the background, the text and the decorations of each run
+        int runStart = 0;
+        for(int j=1; j<=xcount; j++) {
+            if (j<xcount) {
+                const TermChar &cur = line.at(j);
+                const TermChar &first = line.at(runStart);
+                if ((cur.attrib & ~attribCellFlags) == (first.attrib & ~attribCellFlags) &&
+                    cur.bgColor == first.bgColor &&
+                    cur.fgColor == first.fgColor)
+                {
+                    continue;
+                }
             }
+            addFragment(line, runStart, j, leftmargin + runStart*iFontWidth, y, dimmed);
+            runStart = j;
+        }
+    }
+}
 
-            if (currAttrib.attrib != nextAttrib.attrib ||
-                currAttrib.bgColor != nextAttrib.bgColor ||
-                currAttrib.fgColor != nextAttrib.fgColor ||
-                j==xcount-1)
-            {
-                drawBgFragment(painter, currentX, y-iFontHeight+iFontDescent, fragWidth, currAttrib);
-                currentX += fragWidth;
-                fragWidth = 0;
-                currAttrib.attrib = nextAttrib.attrib;
-                currAttrib.bgColor = nextAttrib.bgColor;
-                currAttrib.fgColor = nextAttrib.fgColor;
-            }
+void TextRender::addFragment(const QList<TermChar>& line, int from, int to, float x, float y, bool dimmed)
+{
+    const TermChar &style = line.at(from);
+    const float width = (to-from)*iFontWidth;
+    int fg, bg;
+    resolveColors(style, fg, bg);
+    const bool defaultBg = (bg == iTerm->defaultBgColor);
+    fg = colorIndex(fg);
+    bg = colorIndex(bg);
+
+    if (!defaultBg)
+        scratchAppend(batchFor(bg, dimmed).rects, QRectF(x, y-iFontHeight+iFontDescent, width, iFontHeight), iPaintAllocations);
+
+    if (style.attrib & attribUnderline)
+        scratchAppend(batchFor(fg, dimmed).lines, QLineF(x, y+iFontUnderlinePos, x+width, y+iFontUnderlinePos), iPaintAllocations);
+    if (style.attrib & attribStrikethrough)
+        scratchAppend(batchFor(fg, dimmed).lines, QLineF(x, y-iFontStrikeOutPos, x+width, y-iFontStrikeOutPos), iPaintAllocations);
+
+    // box drawing and block characters come from the glyph cache, the
+    // text in between them is drawn with the font
+    const bool bold = style.attrib & attribBold;
+    int textStart = from;
+    for(int j=from; j<=to; j++) {
+        if (j<to && !GlyphCache::isProcedural(line.at(j).c))
+            continue;
+        if (j > textStart)
+            addTextFragment(line, textStart, j, x + (textStart-from)*iFontWidth, y, fg, bold, dimmed);
+        if (j<to) {
+            GlyphBlit blit;
+            blit.pos = QPointF(x + (j-from)*iFontWidth, y-iFontHeight+iFontDescent);
+            blit.code = line.at(j).c;
+            blit.fg = fg;
+            blit.dimmed = dimmed;
+            scratchAppend(iGlyphBlits, blit, iPaintAllocations);
         }
+        textStart = j+1;
+    }
+}
 
-        // text for the current line
-        QString line;
-        currentX = leftmargin;
-        painter->setBrush(Qt::transparent);
-        for (int j=0; j<xcount; j++) {
-            tmp = buffer[i][j];
-            line += tmp.c;
-            if (j==0) {
-                currAttrib = tmp;
-                nextAttrib = tmp;
-            } else if(j<xcount-1) {
-                nextAttrib = buffer[i][j+1];
-            }
+void TextRender::addTextFragment(const QList<TermChar>& line, int from, int to, float x, float y, int fg, bool bold, bool dimmed)
+{
+    // Split where the font resolved for the characters changes. Spaces fit
+    // in any font, and leading spaces are skipped so that runs of plain
+    // spaces have nothing left to draw. Double width characters are drawn
+    // one by one, their advance in the font rarely matches two cells.
+    int fragmentStart = -1;
+    int fragmentFont = 0;
+    bool fragmentWide = false;
+    for(int j=from; j<=to; j++) {
+        int font = fragmentFont;
+        bool wide = false;
+        if (j<to) {
+            const uint c = line.at(j).c;
+            if (c == ' ')
+                continue;
+            font = iFontFallback.fontIndex(iTerm->baseCodepoint(c));
+            wide = j+1 < line.size() && (line.at(j+1).attrib & attribWideTail);
+            if (fragmentStart != -1 && font == fragmentFont && !wide && !fragmentWide)
+                continue;
+        }
 
-            if (currAttrib.attrib != nextAttrib.attrib ||
-                currAttrib.bgColor != nextAttrib.bgColor ||
-                currAttrib.fgColor != nextAttrib.fgColor ||
-                j==xcount-1)
-            {
-                drawTextFragment(painter, currentX, y, line, currAttrib);
-                currentX += iFontWidth*line.length();
-                line.clear();
-                currAttrib.attrib = nextAttrib.attrib;
-                currAttrib.bgColor = nextAttrib.bgColor;
-                currAttrib.fgColor = nextAttrib.fgColor;
-            }
+        if (fragmentStart != -1) {
+            // the text is referenced, not copied; it is built into the
+            // shared fragment string only when the fragment is drawn
+            TextFragment fragment;
+            fragment.pos = QPointF(x + (fragmentStart-from)*iFontWidth, y);
+            fragment.line = &line;
+            fragment.from = fragmentStart;
+            fragment.to = j;
+            fragment.fg = fg;
+            fragment.font = fragmentFont;
+            fragment.bold = bold;
+            fragment.dimmed = dimmed;
+            scratchAppend(iTextFragments, fragment, iPaintAllocations);
         }
+        fragmentStart = j;
+        fragmentFont = font;
+        fragmentWide = wide;
     }
 }
 
-void TextRender::drawBgFragment(QPainter* painter, float x, float y, float width, TermChar style)
+int TextRender::colorIndex(int color)
 {
-    int bg = style.bgColor;
-    int fg = style.fgColor;
-    if (style.attrib & attribNegative) {
-        int c = fg;
-        fg = bg;
-        bg = c;
+    if (!(color & colorRgbFlag))
+        return color;
+
+    QHash<int, int>::const_iterator i = iRgbColors.constFind(color);
+    if (i != iRgbColors.constEnd())
+        return i.value();
+
+    // a 24-bit color gets a palette entry of its own the first time it is
+    // seen, with its pens and brush, so it is drawn like any other entry
+    const QColor rgb(QRgb(color & 0xFFFFFF));
+    const int index = iColorTable.size();
+    iColorTable.append(rgb);
+    iColorPens.append(QPen(rgb));
+    iColorBrushes.append(QBrush(rgb));
+    iDecorationPens.append(QPen(rgb, iFontLineWidth));
+    iRgbColors.insert(color, index);
+    iPaintAllocations++;
+
+    return index;
+}
+
+void TextRender::dropRgbColors()
+{
+    // only between frames, the entries are referenced while collecting
+    const int paletteSize = 256+3;
+    while (iColorTable.size() > paletteSize)
+        iColorTable.removeLast();
+    iColorPens.resize(paletteSize);
+    iColorBrushes.resize(paletteSize);
+    iDecorationPens.resize(paletteSize);
+    iRgbColors.clear();
+}
+
+TextRender::PaintBatch& TextRender::batchFor(int color, bool dimmed)
+{
+    int slot = color*2 + (dimmed ? 1 : 0);
+    if (iBatches.size() <= slot) {
+        iBatches.resize(slot+1);
+        iPaintAllocations++;
     }
 
-    if (bg == iTerm->defaultBgColor)
-        return;
+    PaintBatch &batch = iBatches[slot];
+    if (batch.rects.isEmpty() && batch.lines.isEmpty())
+        scratchAppend(iUsedBatches, slot, iPaintAllocations);
+
+    return batch;
+}
+
+void TextRender::flushBatches(QPainter* painter)
+{
+    const int usedCount = iUsedBatches.size();
+
+    // backgrounds: one fill call per color
+    painter->setPen(Qt::NoPen);
+    for(int i=0; i<usedCount; i++) {
+        const int slot = iUsedBatches.at(i);
+        const PaintBatch &batch = iBatches.at(slot);
+        if (batch.rects.isEmpty())
+            continue;
+        painter->setOpacity(slot & 1 ? 0.3 : 1.0);
+        painter->setBrush(iColorBrushes.at(slot/2));
+        painter->drawRects(batch.rects.constData(), batch.rects.size());
+        iPaintDrawCalls++;
+    }
 
-    painter->setBrush( iColorTable[bg] );
-    painter->drawRect(x, y, width, iFontHeight);
+    // procedurally drawn glyphs; the ones drawn for this frame count as
+    // allocations
+    const int glyphMisses = iGlyphCache.misses();
+    for(int i=0; i<iGlyphBlits.size(); i++) {
+        const GlyphBlit &blit = iGlyphBlits.at(i);
+        painter->setOpacity(blit.dimmed ? 0.3 : 1.0);
+        painter->drawImage(blit.pos, iGlyphCache.glyph(blit.code, iColorTable.at(blit.fg).rgb()));
+        iPaintDrawCalls++;
+    }
+    iPaintAllocations += iGlyphCache.misses() - glyphMisses;
+
+    // text on top of the backgrounds
+    painter->setBrush(Qt::NoBrush);
+    for(int i=0; i<iTextFragments.size(); i++)
+        drawTextFragment(painter, iTextFragments.at(i));
+
+    // underline and strikethrough: one line batch per color
+    for(int i=0; i<usedCount; i++) {
+        const int slot = iUsedBatches.at(i);
+        const PaintBatch &batch = iBatches.at(slot);
+        if (batch.lines.isEmpty())
+            continue;
+        painter->setOpacity(slot & 1 ? 0.3 : 1.0);
+        painter->setPen(iDecorationPens.at(slot/2));
+        painter->drawLines(batch.lines.constData(), batch.lines.size());
+        iPaintDrawCalls++;
+    }
+
+    for(int i=0; i<usedCount; i++) {
+        PaintBatch &batch = iBatches[iUsedBatches.at(i)];
+        batch.rects.resize(0);
+        batch.lines.resize(0);
+    }
+    iUsedBatches.resize(0);
+    iTextFragments.resize(0);
+    iGlyphBlits.resize(0);
 }
 
-void TextRender::drawTextFragment(QPainter* painter, float x, float y, QString text, TermChar style)
+void TextRender::resolveColors(const TermChar& style, int& fg, int& bg)
 {
-    int bg = style.bgColor;
-    int fg = style.fgColor;
+    bg = style.bgColor;
+    fg = style.fgColor;
     if (style.attrib & attribNegative) {
         int c = fg;
         fg = bg;
         bg = c;
     }
     if (style.attrib & attribBold) {
-        iFont.setBold(true);
-        painter->setFont(iFont);
         if(fg < 8)
             fg += 8;
         if (fg == 257)
             fg++;
-    } else if (iFont.bold()) {
-        iFont.setBold(false);
-        painter->setFont(iFont);
+    }
+}
+
+void TextRender::drawTextFragment(QPainter* painter, const TextFragment& fragment)
+{
+    if (fragment.bold != iPaintBold || fragment.font != iPaintFont) {
+        if (fragment.font == 0)
+            painter->setFont(fragment.bold ? iBoldFont : iFont);
+        else
+            painter->setFont(iFontFallback.font(fragment.font, fragment.bold));
+        iPaintBold = fragment.bold;
+        iPaintFont = fragment.font;
     }
 
-    painter->setPen( iColorTable[fg] );
-    painter->drawText(x, y, text);
+    // reuse one string for all fragments; resize() keeps the capacity as
+    // long as the string is not shared. Cells outside the BMP take a
+    // surrogate pair, grapheme clusters as much as their text.
+    int length = 0;
+    for(int j=fragment.from; j<fragment.to; j++) {
+        const uint c = fragment.line->at(j).c;
+        length += c < 0x10000 ? 1 : (c < clusterBase ? 2 : iTerm->cluster(c).size());
+    }
+    if (iFragmentText.capacity() < length) {
+        iFragmentText.reserve(qMax(length, 2*iFragmentText.capacity()));
+        iPaintAllocations++;
+    }
+    iFragmentText.resize(length);
+    QChar *text = iFragmentText.data();
+    for(int j=fragment.from; j<fragment.to; j++) {
+        const uint c = fragment.line->at(j).c;
+        if (c < 0x10000) {
+            *text++ = QChar(ushort(c));
+        } else if (c < clusterBase) {
+            *text++ = QChar(QChar::highSurrogate(c));
+            *text++ = QChar(QChar::lowSurrogate(c));
+        } else {
+            const QString &cluster = iTerm->cluster(c);
+            for(int k=0; k<cluster.size(); k++)
+                *text++ = cluster.at(k);
+        }
+    }
+
+    painter->setOpacity(fragment.dimmed ? 0.3 : 1.0);
+    painter->setPen(iColorPens.at(fragment.fg));
+    painter->drawText(fragment.pos, iFragmentText);
+    iPaintDrawCalls++;
+}
+
+void TextRender::updatePaintCache()
+{
+    // pens and brushes are created once per palette/font change, setting a
+    // cached one on the painter only shares its data
+    iColorPens.clear();
+    iColorBrushes.clear();
+    iDecorationPens.clear();
+    foreach(const QColor &color, iColorTable) {
+        iColorPens.append(QPen(color));
+        iColorBrushes.append(QBrush(color));
+        iDecorationPens.append(QPen(color, iFontLineWidth));
+    }
+    iSelectionBrush = QBrush(Qt::white);
+
+    iBatches.resize(iColorTable.size()*2);
 }
 
 void TextRender::redraw()
 {
+    if (iShowPerformanceHud)
+        iHudRedraws++;
+    update();
+}
+
+void TextRender::setShowPerformanceHud(bool show)
+{
+    if (iShowPerformanceHud == show)
+        return;
+
+    iShowPerformanceHud = show;
+    if (show) {
+        iHudStats = iTerm ? iTerm->stats() : TermStats();
+        iHudFrames = 0;
+        iHudRedraws = 0;
+        iHudPaintNsecs = 0;
+        iHudLines = QStringList() << "measuring...";
+        iHudClock.start();
+        iHudTimer.start();
+    } else {
+        iHudTimer.stop();
+        iHudLines.clear();
+    }
+    emit showPerformanceHudChanged();
+    update();
+}
+
+void TextRender::updatePerformanceHud()
+{
+    if (!iTerm)
+        return;
+
+    const double secs = iHudClock.restart() / 1000.0;
+    if (secs <= 0)
+        return;
+    const TermStats &stats = iTerm->stats();
+    const quint64 bytes = stats.bytesRead - iHudStats.bytesRead;
+    const quint64 reads = stats.reads - iHudStats.reads;
+
+    // QList keeps cells, which are larger than a pointer, in nodes of their own
+    qint64 cells = 0;
+    const QList<QList<TermChar> > &backBuffer = iTerm->backBuffer();
+    for (int i=0; i<backBuffer.size(); i++)
+        cells += backBuffer.at(i).size();
+    const qint64 scrollbackBytes = cells * (sizeof(TermChar) + sizeof(void*));
+
+    iHudLines.clear();
+    iHudLines << QString("%1 kB/s  %2 seq/s").arg(bytes / secs / 1024, 0, 'f', 1)
+                 .arg(qRound((stats.sequences - iHudStats.sequences) / secs))
+              << QString("%1 fps  paint %2 ms").arg(iHudFrames / secs, 0, 'f', 1)
+                 .arg(iHudPaintNsecs / 1e6, 0, 'f', 2)
+              << QString("%1 redraws coalesced").arg(qMax(0, iHudRedraws - iHudFrames))
+              << QString("scrollback %1 lines  %2 kB").arg(backBuffer.size()).arg(scrollbackBytes / 1024)
+              << QString("%1 reads/s  %2 B/read").arg(qRound(reads / secs)).arg(reads ? bytes / reads : 0);
+
+    iHudStats = stats;
+    iHudFrames = 0;
+    iHudRedraws = 0;
     update();
 }
 
+void TextRender::paintPerformanceHud(QPainter* painter)
+{
+    QFontMetrics metrics(iFont);
+    int width = 0;
+    foreach(const QString &line, iHudLines)
+        width = qMax(width, metrics.width(line));
+    const int lineHeight = metrics.height();
+    const QRect box(iWidth - width - 8, 0, width + 8, iHudLines.size() * lineHeight + 4);
+
+    painter->setOpacity(0.7);
+    painter->setPen(Qt::NoPen);
+    painter->setBrush(Qt::black);
+    painter->drawRect(box);
+
+    painter->setOpacity(1.0);
+    painter->setFont(iFont);
+    painter->setPen(Qt::yellow);
+    for (int i=0; i<iHudLines.size(); i++)
+        painter->drawText(box.left() + 4, 2 + i*lineHeight + metrics.ascent(), iHudLines.at(i));
+}
+
 void TextRender::setTerminal(Terminal *term)
 {
-    if (!iUtil)
-        qFatal("textrender: util class not set");
+    if (!iSettings)
+        qFatal("textrender: settings not set");
 
     iTerm = term;
 
-    iFont = QFont(iUtil->settingsValue("ui/fontFamily").toString(),
-                  iUtil->settingsValue("ui/fontSize").toInt());
+    iFont = QFont(iSettings->settingsValue("ui/fontFamily").toString(),
+                  iSettings->settingsValue("ui/fontSize").toInt());
     iFont.setBold(false);
     iFont.setStyleHint(QFont::Monospace);
     iFont.setFixedPitch(true);
     iFont.setKerning(false);
     iFont.setStyleStrategy(QFont::ForceIntegerMetrics);
+    updateFontMetrics();
+
+    updateTermSize();
+    connect(iTerm, SIGNAL(displayBufferChanged()), this, SLOT(redraw()));
+    connect(iTerm, SIGNAL(cursorPosChanged(QPoint)), this, SLOT(redraw()));
+    connect(iTerm, SIGNAL(termSizeChanged(QSize)), this, SLOT(redraw()));
+    connect(iTerm, SIGNAL(selectionChanged()), this, SLOT(redraw()));
+    connect(iTerm, SIGNAL(backBufferScrollPosChanged()), this, SLOT(updateScrollIndicator()));
+    connect(iTerm, SIGNAL(performanceHudRequested(bool)), this, SLOT(setShowPerformanceHud(bool)));
+
+    setShowPerformanceHud(iSettings->settingsValue("ui/showPerformanceHud").toBool());
+}
+
+void TextRender::updateScrollIndicator()
+{
+    setShowBufferScrollIndicator(iTerm->backBufferScrollPos() != 0);
+    redraw();
+}
+
+void TextRender::updateFontMetrics()
+{
     QFontMetrics fontMetrics(iFont);
     iFontHeight = fontMetrics.height();
     iFontWidth = fontMetrics.maxWidth();
     iFontDescent = fontMetrics.descent();
     iFontAscent = fontMetrics.ascent();
+    iFontUnderlinePos = fontMetrics.underlinePos();
+    iFontStrikeOutPos = fontMetrics.strikeOutPos();
+    iFontLineWidth = fontMetrics.lineWidth();
+
+    iBoldFont = iFont;
+    iBoldFont.setBold(true);
+
+    iGlyphCache.setCellSize(qRound(iFontWidth), qRound(iFontHeight));
+    iFontFallback.setFont(iFont);
+
+    updatePaintCache();
 }
 
 QFont TextRender::getFont() {
     return iFont;
 }
 
+void TextRender::scheduleTermSize()
+{
+    // a rotation changes both the width and the height; the terminal (and
+    // the program in it) only sees the size they settle to
+    if (!iResizeTimer.isActive())
+        iResizeTimer.start();
+}
+
 void TextRender::updateTermSize()
 {
+    iResizeTimer.stop();
+
     if (!iTerm)
         return;
 
@@ -374,17 +740,23 @@ void TextRender::setFontPointSize(int psize)
     {
         iFont.setBold(false);
         iFont.setPointSize(psize);
-        QFontMetrics fontMetrics(iFont);
-        iFontHeight = fontMetrics.height();
-        iFontWidth = fontMetrics.maxWidth();
-        iFontDescent = fontMetrics.descent();
+        updateFontMetrics();
 
-        iUtil->setSettingsValue("ui/fontSize", psize);
+        iSettings->setSettingsValue("ui/fontSize", psize);
 
         emit fontSizeChanged();
     }
 }
 
+int TextRender::pinchFontPointSize(qreal scale)
+{
+    // same range as the font size slider in the settings
+    const int minSize = 11;
+    const int maxSize = qMax(minSize, iSettings->settingsValue("ui/maxFontSize").toInt());
+
+    return qBound(minSize, qRound(iFont.pointSize()*scale), maxSize);
+}
+
 QPoint TextRender::cursorPixelPos()
 {
     return charsToPixels(iTerm->cursorPos());
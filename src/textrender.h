@@ -22,10 +22,11 @@
 
 #include <QQuickPaintedItem>
 #include <QPainter>
+#include <QTimer>
 
 #include "terminal.h"
-
-class Util;
+#include "glyphcache.h"
+#include "fontfallback.h"
 
 class TextRender : public QQuickPaintedItem
 {
@@ -35,6 +36,8 @@ class TextRender : public QQuickPaintedItem
     Q_PROPERTY(int fontHeight READ fontHeight NOTIFY fontSizeChanged)
     Q_PROPERTY(int fontPointSize READ fontPointSize WRITE setFontPointSize NOTIFY fontSizeChanged)
     Q_PROPERTY(bool showBufferScrollIndicator READ showBufferScrollIndicator WRITE setShowBufferScrollIndicator NOTIFY showBufferScrollIndicatorChanged)
+    Q_PROPERTY(int cutAfter READ cutAfter WRITE setCutAfter NOTIFY cutAfterChanged)
+    Q_PROPERTY(bool showPerformanceHud READ showPerformanceHud WRITE setShowPerformanceHud NOTIFY showPerformanceHudChanged)
 
     Q_OBJECT
 public:
@@ -43,7 +46,7 @@ public:
     void paint(QPainter*);
 
     void setTerminal(Terminal* term);
-    void setUtil(Util* util) { iUtil = util; }
+    void setSettings(TermSettings* settings) { iSettings = settings; }
 
     int myWidth() { return iWidth; }
     int myHeight() { return iHeight; }
@@ -57,10 +60,24 @@ public:
     void setFontPointSize(int psize);
     bool showBufferScrollIndicator() { return iShowBufferScrollIndicator; }
     void setShowBufferScrollIndicator(bool s) { if(iShowBufferScrollIndicator!=s) { iShowBufferScrollIndicator=s; emit showBufferScrollIndicatorChanged(); } }
+    int cutAfter() { return iCutAfter; }
+    void setCutAfter(int c) { if(iCutAfter!=c) { iCutAfter=c; emit cutAfterChanged(); update(); } }
+    bool showPerformanceHud() { return iShowPerformanceHud; }
+
+    // number of times the paint scratch buffers had to grow, stays constant
+    // once the renderer has warmed up
+    Q_INVOKABLE int paintAllocations() { return iPaintAllocations; }
+
+    // painter calls (fills, text runs, images, lines) of the last frame
+    Q_INVOKABLE int paintDrawCalls() { return iPaintDrawCalls; }
 
     Q_INVOKABLE QPoint cursorPixelPos();
     Q_INVOKABLE QSize cursorPixelSize();
 
+    // point size a pinch gesture of the given scale settles to, within the
+    // limits of the font size setting
+    Q_INVOKABLE int pinchFontPointSize(qreal scale);
+
     QColor qColorFromHex(QString hex);
     void updatePalette();
     Q_INVOKABLE void loadColorScheme(QString layoutName);
@@ -72,33 +89,119 @@ signals:
     void myHeightChanged(int newHeight);
     void fontSizeChanged();
     void showBufferScrollIndicatorChanged();
+    void cutAfterChanged();
+    void showPerformanceHudChanged();
 
 public slots:
     void redraw();
     void updateTermSize();
+    void setShowPerformanceHud(bool show);
+
+private slots:
+    void scheduleTermSize();
+    void updateScrollIndicator();
+    void updatePerformanceHud();
 
 private:
     Q_DISABLE_COPY(TextRender)
 
-    void paintFromBuffer(QPainter* painter, QList<QList<TermChar> >& buffer, int from, int to, int &y);
-    void drawBgFragment(QPainter* painter, float x, float y, float width, TermChar style);
-    void drawTextFragment(QPainter* painter, float x, float y, QString text, TermChar style);
+    // Geometry collected for one color (and opacity) during a paint pass,
+    // submitted with a single draw call per batch when the frame is flushed.
+    struct PaintBatch {
+        QVector<QRectF> rects;
+        QVector<QLineF> lines;
+    };
+    struct TextFragment {
+        QPointF pos;
+        const QList<TermChar>* line;
+        int from;
+        int to;
+        int fg;
+        int font;
+        bool bold;
+        bool dimmed;
+    };
+    struct GlyphBlit {
+        QPointF pos;
+        uint code;
+        int fg;
+        bool dimmed;
+    };
+
+    void paintFromBuffer(const QList<QList<TermChar> >& buffer, int from, int to, int &y);
+    void addFragment(const QList<TermChar>& line, int from, int to, float x, float y, bool dimmed);
+    void addTextFragment(const QList<TermChar>& line, int from, int to, float x, float y, int fg, bool bold, bool dimmed);
+    void flushBatches(QPainter* painter);
+    PaintBatch& batchFor(int color, bool dimmed);
+    void resolveColors(const TermChar& style, int& fg, int& bg);
+    int colorIndex(int color);
+    void dropRgbColors();
+    void drawTextFragment(QPainter* painter, const TextFragment& fragment);
+    void paintPerformanceHud(QPainter* painter);
+    void updateFontMetrics();
+    void updatePaintCache();
     QPoint charsToPixels(QPoint pos);
 
     int iWidth;
     int iHeight;
     QFont iFont;
+    QFont iBoldFont;
     float iFontWidth;
     float iFontHeight;
     float iFontDescent;
     float iFontAscent;
+    float iFontUnderlinePos;
+    float iFontStrikeOutPos;
+    float iFontLineWidth;
     bool iShowBufferScrollIndicator;
+    int iCutAfter;
+
+    // width, height and font changes of one layout pass become one resize
+    QTimer iResizeTimer;
+
+    // performance HUD: counters since its last update, once a second while
+    // it is shown; nothing is counted or timed while it is not
+    static const int performanceHudInterval = 1000;  // ms
+    bool iShowPerformanceHud;
+    QTimer iHudTimer;
+    QElapsedTimer iHudClock;
+    TermStats iHudStats;
+    int iHudFrames;
+    int iHudRedraws;
+    qint64 iHudPaintNsecs;
+    QStringList iHudLines;
+
+    bool iPaintBold;
+    int iPaintFont;
+    int iPaintFrames;
+    int iPaintAllocations;
+    int iPaintAllocationsReported;
+    int iPaintDrawCalls;
 
     Terminal *iTerm;
-    Util *iUtil;
+    TermSettings *iSettings;
 
     QList<QColor> iColorTable;
 
+    QVector<QPen> iColorPens;
+    QVector<QBrush> iColorBrushes;
+    QVector<QPen> iDecorationPens;
+    QBrush iSelectionBrush;
+
+    // per-frame scratch storage, reused from frame to frame
+    QVector<PaintBatch> iBatches;
+    QVector<int> iUsedBatches;
+
+    // palette entries given to 24-bit colors, by color
+    QHash<int, int> iRgbColors;
+    static const int maxRgbColors = 1024;
+    QVector<TextFragment> iTextFragments;
+    QVector<GlyphBlit> iGlyphBlits;
+    QString iFragmentText;
+
+    GlyphCache iGlyphCache;
+    FontFallback iFontFallback;
+
     QSettings *colorScheme;
 };
 
@@ -0,0 +1,119 @@
+/*
+    ThumbTerm Copyright Olli Vanhoja
+    FingerTerm Copyright 2011-2012 Heikki Holstila <heikki.holstila@gmail.com>
+    ToeTerm Copyright 2018 ROZZ, 2019 Matti Viljanen
+
+    This file is part of ToeTerm.
+
+    ToeTerm is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    ToeTerm is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ToeTerm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "trace.h"
+
+#ifdef TOETERM_TRACE
+
+QBasicAtomicInt Trace::iActive = Q_BASIC_ATOMIC_INITIALIZER(0);
+QElapsedTimer Trace::iClock;
+QMutex Trace::iFileMutex;
+QFile Trace::iFile;
+QList<Trace::ThreadBuffer*> Trace::iBuffers;
+bool Trace::iFirstEvent = true;
+
+bool Trace::start(const QString &path)
+{
+    QMutexLocker lock(&iFileMutex);
+    if(iFile.isOpen())
+        return false;
+
+    iFile.setFileName(path);
+    if(!iFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "cannot trace to" << path << iFile.errorString();
+        return false;
+    }
+    iFile.write("[\n");
+    iFirstEvent = true;
+    iClock.start();
+    iActive.store(1);
+    qDebug() << "tracing to" << path;
+    return true;
+}
+
+void Trace::stop()
+{
+    if(!isActive())
+        return;
+    iActive.store(0);
+
+    QList<ThreadBuffer*> buffers;
+    {
+        QMutexLocker lock(&iFileMutex);
+        buffers = iBuffers;
+    }
+    foreach(ThreadBuffer* buffer, buffers)
+        flush(buffer);
+
+    QMutexLocker lock(&iFileMutex);
+    iFile.write("\n]\n");
+    iFile.close();
+    // the buffers stay, threads may still hold a pointer to theirs
+}
+
+Trace::ThreadBuffer* Trace::threadBuffer()
+{
+    static thread_local ThreadBuffer* buffer = 0;
+    if(!buffer) {
+        buffer = new ThreadBuffer;
+        buffer->events.reserve(eventsPerFlush);
+        QMutexLocker lock(&iFileMutex);
+        buffer->tid = iBuffers.count() + 1;
+        iBuffers.append(buffer);
+    }
+    return buffer;
+}
+
+void Trace::complete(const char *name, qint64 start, qint64 end)
+{
+    ThreadBuffer* buffer = threadBuffer();
+    Event event = { name, start, end };
+    buffer->events.append(event);
+    if(buffer->events.size() >= eventsPerFlush)
+        flush(buffer);
+}
+
+void Trace::flush(ThreadBuffer *buffer)
+{
+    QByteArray out;
+    foreach(const Event& event, buffer->events) {
+        out += QString("{\"name\":\"%1\",\"cat\":\"toeterm\",\"ph\":\"X\",\"ts\":%2,\"dur\":%3,\"pid\":1,\"tid\":%4}")
+                .arg(event.name)
+                .arg(event.start / 1000.0, 0, 'f', 3)
+                .arg((event.end - event.start) / 1000.0, 0, 'f', 3)
+                .arg(buffer->tid).toLatin1();
+        out += ",\n";
+    }
+    buffer->events.resize(0);
+    if(out.isEmpty())
+        return;
+    out.chop(2);
+
+    QMutexLocker lock(&iFileMutex);
+    if(!iFile.isOpen())
+        return;
+    if(!iFirstEvent)
+        iFile.write(",\n");
+    iFile.write(out);
+    iFirstEvent = false;
+}
+
+#endif // TOETERM_TRACE
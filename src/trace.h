@@ -0,0 +1,101 @@
+/*
+    ThumbTerm Copyright Olli Vanhoja
+    FingerTerm Copyright 2011-2012 Heikki Holstila <heikki.holstila@gmail.com>
+    ToeTerm Copyright 2018 ROZZ, 2019 Matti Viljanen
+
+    This file is part of ToeTerm.
+
+    ToeTerm is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    ToeTerm is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ToeTerm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QtCore>
+
+// Trace points for a timeline of where the time goes, written as Chrome
+// trace events (chrome://tracing, Perfetto). They only exist in a build
+// configured with CONFIG+=trace; otherwise TRACE_SCOPE is empty and
+// start() and stop() do nothing.
+//
+// Each thread appends to a buffer of its own without locking, and writes
+// it out to the file itself when it is full. The rest is written by stop(),
+// when the other threads are done.
+
+#ifdef TOETERM_TRACE
+
+class Trace
+{
+public:
+    static bool start(const QString& path);
+    static void stop();
+
+    static bool isActive() { return iActive.load() != 0; }
+    static qint64 now() { return iClock.nsecsElapsed(); }
+    static void complete(const char* name, qint64 start, qint64 end);
+
+private:
+    struct Event {
+        const char* name;
+        qint64 start;
+        qint64 end;
+    };
+    struct ThreadBuffer {
+        int tid;
+        QVector<Event> events;
+    };
+
+    static const int eventsPerFlush = 16384;
+
+    static ThreadBuffer* threadBuffer();
+    static void flush(ThreadBuffer* buffer);
+
+    static QBasicAtomicInt iActive;
+    static QElapsedTimer iClock;
+    static QMutex iFileMutex;  // also guards iBuffers
+    static QFile iFile;
+    static QList<ThreadBuffer*> iBuffers;
+    static bool iFirstEvent;
+};
+
+// times the rest of the enclosing block; the name must be a string literal
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name) :
+        iName(name), iStart(Trace::isActive() ? Trace::now() : -1) {}
+    ~TraceScope() { if(iStart >= 0) Trace::complete(iName, iStart, Trace::now()); }
+
+private:
+    Q_DISABLE_COPY(TraceScope)
+    const char* iName;
+    qint64 iStart;
+};
+
+#define TRACE_SCOPE(name) TraceScope traceScope(name)
+
+#else
+
+class Trace
+{
+public:
+    static bool start(const QString&) { return false; }
+    static void stop() {}
+};
+
+#define TRACE_SCOPE(name)
+
+#endif // TOETERM_TRACE
+
+#endif // TRACE_H
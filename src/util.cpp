@@ -44,6 +44,10 @@ Util::Util(QSettings *settings, QObject *parent) :
     swipeModeSet = false;
     swipeAllowed = true;
 
+    iTitleTimer.setSingleShot(true);
+    iTitleTimer.setInterval(titleUpdateDelay);
+    connect(&iTitleTimer, SIGNAL(timeout()), this, SLOT(applyWindowTitle()));
+
     connect(QGuiApplication::clipboard(), SIGNAL(dataChanged()), this, SIGNAL(clipboardOrSelectionChanged()));
 }
 
@@ -55,7 +59,18 @@ Util::~Util()
 
 void Util::setWindowTitle(QString title)
 {
-    iCurrentWinTitle = title;
+    // shells may set the title with every prompt, apply only the latest
+    // one now and then
+    iPendingWinTitle = title;
+    if(!iTitleTimer.isActive())
+        iTitleTimer.start();
+}
+
+void Util::applyWindowTitle()
+{
+    if(iPendingWinTitle == iCurrentWinTitle)
+        return;
+    iCurrentWinTitle = iPendingWinTitle;
     emit windowTitleChanged();
 }
 
@@ -279,6 +294,16 @@ void Util::copyTextToClipboard(QString str)
     cb->setText(str);
 }
 
+QString Util::clipboardText()
+{
+    return QGuiApplication::clipboard()->text();
+}
+
+void Util::setClipboardText(const QString &text)
+{
+    copyTextToClipboard(text);
+}
+
 bool Util::terminalHasSelection()
 {
     return !iTerm->selection().isNull();
@@ -296,16 +321,3 @@ void Util::selectionFinished()
 {
     emit clipboardOrSelectionChanged();
 }
-
-//static
-bool Util::charIsHexDigit(QChar ch)
-{
-    if (ch.isDigit()) // 0-9
-        return true;
-    else if (ch.toLatin1() >= 65 && ch.toLatin1() <= 70) // A-F
-        return true;
-    else if (ch.toLatin1() >= 97 && ch.toLatin1() <= 102) // a-f
-        return true;
-
-    return false;
-}
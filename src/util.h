@@ -24,17 +24,18 @@
 
 #include <QtCore>
 
+#include "terminalinterfaces.h"
+
 class Terminal;
 class TextRender;
 class QQuickView;
 
-class Util : public QObject
+class Util : public QObject, public TermClipboard, public TermBell, public TermSettings
 {
     Q_OBJECT
 public:
     explicit Util(QSettings* settings, QObject *parent = 0);
     virtual ~Util();
-    void setWindowTitle(QString title);
     Q_INVOKABLE QString currentWindowTitle();
     void setTerm(Terminal* term) { iTerm = term; }
     void setRenderer(TextRender* r) { iRenderer = r; }
@@ -58,21 +59,27 @@ public:
     Q_INVOKABLE bool canPaste();
     Q_INVOKABLE bool terminalHasSelection();
 
+    QString clipboardText();
+    void setClipboardText(const QString& text);
+
     void bellAlert();
-    void selectionFinished();
 
     bool allowGestures() { return iAllowGestures; }
     void setAllowGestures(bool a) { if(iAllowGestures!=a) { iAllowGestures=a; emit allowGesturesChanged(); } }
 
     Q_PROPERTY(bool allowGestures READ allowGestures WRITE setAllowGestures NOTIFY allowGesturesChanged)
 
-    static bool charIsHexDigit(QChar ch);
-
 public slots:
+    void setWindowTitle(QString title);
+    void selectionFinished();
+
     void mousePress(float eventX, float eventY);
     void mouseMove(float eventX, float eventY);
     void mouseRelease(float eventX, float eventY);
 
+private slots:
+    void applyWindowTitle();
+
 signals:
     void visualBell();
     void allowGesturesChanged();
@@ -83,6 +90,7 @@ signals:
 private:
     Q_DISABLE_COPY(Util)
     enum PanGesture { PanNone, PanLeft, PanRight, PanUp, PanDown };
+    static const int titleUpdateDelay = 100;  // ms
 
     void enableSwipe();
     void disableSwipe();
@@ -101,6 +109,8 @@ private:
     bool newSelection;
 
     QString iCurrentWinTitle;
+    QString iPendingWinTitle;
+    QTimer iTitleTimer;
 
     QSettings* iSettings;
     Terminal* iTerm;
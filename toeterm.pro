@@ -1,52 +1,26 @@
-TARGET = toeterm
-CONFIG += sailfishapp link_pkgconfig
-PKGCONFIG += sailfishapp nemonotifications-qt5
-LIBS += -lutil
-
-QT += feedback
-
-HEADERS += \
-    src/ptyiface.h \
-    src/terminal.h \
-    src/textrender.h \
-    src/util.h \
-    src/keyloader.h
-
-SOURCES += \
-    src/main.cpp \
-    src/terminal.cpp \
-    src/textrender.cpp \
-    src/ptyiface.cpp \
-    src/util.cpp \
-    src/keyloader.cpp
-
-OTHER_FILES += qml/*
-
-RESOURCES += \
-    resources.qrc
-
-target.path = /usr/bin
-INSTALLS += target
-
-SAILFISHAPP_ICONS = 86x86 108x108 128x128 172x172
-
-CONFIG += sailfishapp_i18n
-
-TRANSLATIONS += translations/toeterm-ru.ts \
-    translations/toeterm-nl.ts \
-    translations/toeterm-sv.ts \
-    translations/toeterm-nl_BE.ts \
-    translations/toeterm-es.ts \
-    translations/toeterm-fi_FI.ts \
-    translations/toeterm-zh_CN.ts
-
-DISTFILES += \
-    translations/toeterm-nl.ts \
-    translations/toeterm-ru.ts \
-    rpm/toeterm.yaml \
-    rpm/toeterm.spec \
-    translations/toeterm-sv.ts \
-    translations/toeterm-nl_BE.ts \
-    translations/toeterm-es.ts \
-    translations/toeterm-fi_FI.ts \
-    translations/toeterm-zh_CN.ts
+TEMPLATE = subdirs
+
+# core: parser, screen model and scrollback, no QML or Sailfish dependencies
+# app: the Sailfish application
+# tools: programs running the core (and the renderer) on a plain Linux box,
+#        only built with CONFIG+=tools so that the package stays core + app
+SUBDIRS = core app
+
+app.file = app.pro
+app.depends = core
+
+tools: SUBDIRS += replay bench renderbench latency
+
+replay.subdir = tools/replay
+replay.depends = core
+
+bench.subdir = tools/bench
+bench.depends = core
+
+renderbench.subdir = tools/renderbench
+renderbench.depends = core
+
+latency.subdir = tools/latency
+latency.depends = core
+
+OTHER_FILES += .qmake.conf
@@ -0,0 +1,269 @@
+/*
+    ThumbTerm Copyright Olli Vanhoja
+    FingerTerm Copyright 2011-2012 Heikki Holstila <heikki.holstila@gmail.com>
+    ToeTerm Copyright 2018 ROZZ, 2019 Matti Viljanen
+
+    This file is part of ToeTerm.
+
+    ToeTerm is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    ToeTerm is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ToeTerm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+#include "terminal.h"
+
+// Throughput of the emulator core for a set of synthetic workloads, as JSON.
+// With --baseline, the results of an earlier run are compared against.
+
+static const QChar ESC(0x1B);
+
+// deterministic, so that every run parses the same input
+class Random
+{
+public:
+    Random() : iState(12345) {}
+    int next(int bound) {
+        iState = iState * 1103515245 + 12345;
+        return (iState >> 16) % bound;
+    }
+private:
+    quint32 iState;
+};
+
+static QString words(Random& rnd, int count)
+{
+    static const char* const list[] = { "lorem", "ipsum", "dolor", "sit", "amet", "consectetur",
+                                        "adipiscing", "elit", "sed", "do", "eiusmod", "tempor" };
+    QString line;
+    for(int i=0; i<count; i++) {
+        if(i)
+            line += ' ';
+        line += list[rnd.next(12)];
+    }
+    return line;
+}
+
+static QString asciiText(int bytes)
+{
+    Random rnd;
+    QString out;
+    while(out.size() < bytes)
+        out += words(rnd, 12) + "\r\n";
+    return out;
+}
+
+static QString sgrText(int bytes)
+{
+    Random rnd;
+    QString out;
+    while(out.size() < bytes) {
+        for(int i=0; i<10; i++)
+            out += QString("%1[%2;%3m%4 ").arg(ESC).arg(30 + rnd.next(8)).arg(rnd.next(2) ? 1 : 22).arg(words(rnd, 1));
+        out += QString("%1[0m\r\n").arg(ESC);
+    }
+    return out;
+}
+
+static QString color256Text(int bytes)
+{
+    Random rnd;
+    QString out;
+    while(out.size() < bytes) {
+        for(int i=0; i<10; i++)
+            out += QString("%1[38;5;%2;48;5;%3m%4 ").arg(ESC).arg(rnd.next(256)).arg(rnd.next(256)).arg(words(rnd, 1));
+        out += QString("%1[0m\r\n").arg(ESC);
+    }
+    return out;
+}
+
+static QString truecolorText(int bytes)
+{
+    Random rnd;
+    QString out;
+    while(out.size() < bytes) {
+        for(int i=0; i<10; i++)
+            out += QString("%1[38;2;%2;%3;%4m%5 ").arg(ESC).arg(rnd.next(256)).arg(rnd.next(256)).arg(rnd.next(256)).arg(words(rnd, 1));
+        out += QString("%1[0m\r\n").arg(ESC);
+    }
+    return out;
+}
+
+static QString regionScroll(int bytes, QSize size)
+{
+    // a status line at the top and bottom, the log scrolling between them
+    Random rnd;
+    QString out = QString("%1[2;%2r").arg(ESC).arg(size.height()-1);
+    while(out.size() < bytes)
+        out += QString("%1[%2;1H\n%3").arg(ESC).arg(size.height()-1).arg(words(rnd, 8));
+    out += QString("%1[r").arg(ESC);
+    return out;
+}
+
+static QString fullScreen(int bytes, QSize size)
+{
+    // htop like: every frame redraws each row in place
+    Random rnd;
+    QString out;
+    while(out.size() < bytes) {
+        for(int row=1; row<=size.height(); row++) {
+            out += QString("%1[%2;1H%1[%3m%4%1[K").arg(ESC).arg(row).arg(row == 1 ? 7 : 30 + rnd.next(8))
+                    .arg(words(rnd, 6).left(size.width()));
+        }
+    }
+    return out;
+}
+
+static QString unicodeText(int bytes)
+{
+    // CJK (double width), accented letters with combining marks and emoji
+    static const uint cjk[] = { 0x4E2D, 0x6587, 0x65E5, 0x672C, 0x8A9E, 0xD55C, 0xAD6D };
+    Random rnd;
+    QString out;
+    while(out.size() < bytes) {
+        for(int i=0; i<20; i++) {
+            switch(rnd.next(4)) {
+            case 0: out += QChar(cjk[rnd.next(7)]); break;
+            case 1: out += QString("e") + QChar(0x0301); break;
+            case 2: { const uint emoji = 0x1F600 + rnd.next(60); out += QString::fromUcs4(&emoji, 1); break; }
+            default: out += QChar(0xE4); break;
+            }
+        }
+        out += "\r\n";
+    }
+    return out;
+}
+
+static QString altScreen(int bytes, QSize size)
+{
+    // an editor starting and quitting over and over
+    Random rnd;
+    QString out;
+    while(out.size() < bytes) {
+        out += QString("%1[?1049h%1[H%1[2J").arg(ESC);
+        for(int row=1; row<=size.height(); row++)
+            out += QString("%1[%2;1H%3").arg(ESC).arg(row).arg(words(rnd, 5));
+        out += QString("%1[?1049l").arg(ESC);
+    }
+    return out;
+}
+
+struct Workload {
+    QString name;
+    QString data;
+};
+
+static QJsonObject run(const Workload& workload, QSize size, int iterations)
+{
+    const int chunk = 4096;  // what PtyIFace hands over at a time
+    const qint64 bytes = workload.data.toUtf8().size();
+
+    Terminal term;
+    term.setTermSize(size);
+
+    qint64 best = -1;
+    for(int i=0; i<=iterations; i++) {  // the first round warms up
+        term.insertInBuffer(QString(ESC) + "c");
+        QElapsedTimer timer;
+        timer.start();
+        for(int pos=0; pos<workload.data.size(); pos+=chunk)
+            term.insertInBuffer(workload.data.mid(pos, chunk));
+        const qint64 nsecs = timer.nsecsElapsed();
+        if(i > 0 && (best < 0 || nsecs < best))
+            best = nsecs;
+    }
+
+    QJsonObject result;
+    result.insert("name", workload.name);
+    result.insert("bytes", double(bytes));
+    result.insert("seconds", best / 1e9);
+    result.insert("mbPerSec", bytes / (best / 1e9) / 1e6);
+    result.insert("nsPerByte", double(best) / bytes);
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures the parsing throughput of the terminal core.");
+    parser.addHelpOption();
+    QCommandLineOption sizeOption("size", "Terminal size.", "COLSxROWS", "80x24");
+    QCommandLineOption bytesOption("bytes", "Input per workload, in kilobytes.", "kB", "2048");
+    QCommandLineOption iterationsOption("iterations", "Measured rounds, the best one counts.", "n", "5");
+    QCommandLineOption onlyOption("only", "Run only the named workload.", "name");
+    QCommandLineOption baselineOption("baseline", "Compare with the JSON output of an earlier run.", "file");
+    parser.addOption(sizeOption);
+    parser.addOption(bytesOption);
+    parser.addOption(iterationsOption);
+    parser.addOption(onlyOption);
+    parser.addOption(baselineOption);
+    parser.process(app);
+
+    const QStringList dims = parser.value(sizeOption).split('x');
+    const QSize size = dims.count() == 2 ? QSize(dims.at(0).toInt(), dims.at(1).toInt()) : QSize();
+    if(size.isEmpty())
+        parser.showHelp(2);
+    const int bytes = parser.value(bytesOption).toInt() * 1024;
+    const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+
+    QList<Workload> workloads;
+    workloads << Workload{ "ascii", asciiText(bytes) }
+              << Workload{ "sgr", sgrText(bytes) }
+              << Workload{ "color256", color256Text(bytes) }
+              << Workload{ "truecolor", truecolorText(bytes) }
+              << Workload{ "region-scroll", regionScroll(bytes, size) }
+              << Workload{ "fullscreen", fullScreen(bytes, size) }
+              << Workload{ "unicode", unicodeText(bytes) }
+              << Workload{ "altscreen", altScreen(bytes, size) };
+
+    QHash<QString, double> baseline;
+    if(parser.isSet(baselineOption)) {
+        QFile file(parser.value(baselineOption));
+        if(!file.open(QIODevice::ReadOnly)) {
+            QTextStream(stderr) << "cannot open " << file.fileName() << endl;
+            return 1;
+        }
+        foreach(const QJsonValue& value, QJsonDocument::fromJson(file.readAll()).object().value("workloads").toArray())
+            baseline.insert(value.toObject().value("name").toString(), value.toObject().value("mbPerSec").toDouble());
+    }
+
+    QJsonArray results;
+    foreach(const Workload& workload, workloads) {
+        if(parser.isSet(onlyOption) && parser.value(onlyOption) != workload.name)
+            continue;
+        QJsonObject result = run(workload, size, iterations);
+        if(baseline.value(workload.name) > 0) {
+            const double old = baseline.value(workload.name);
+            result.insert("baselineMbPerSec", old);
+            result.insert("change", result.value("mbPerSec").toDouble() / old - 1.0);
+        }
+        results.append(result);
+    }
+
+    QJsonObject report;
+    report.insert("size", parser.value(sizeOption));
+    report.insert("iterations", iterations);
+    report.insert("workloads", results);
+    QTextStream(stdout) << QJsonDocument(report).toJson();
+    return 0;
+}
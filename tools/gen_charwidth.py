@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+#
+# Generates src/charwidthtable.h, the cell width of every Unicode codepoint
+# for charWidth() in src/charwidth.h. Uses the Unicode database that comes
+# with Python; rerun with a newer Python to pick up a newer Unicode version:
+#
+#   python3 tools/gen_charwidth.py > src/charwidthtable.h
+
+import sys
+import unicodedata
+
+BLOCK = 256
+
+
+def width(code):
+    if 0x1160 <= code <= 0x11FF:  # hangul medial vowels and final consonants
+        return 0
+    if code == 0x00AD:            # soft hyphen is shown
+        return 1
+    if code in (0x200B, 0x2060):  # zero width space, word joiner
+        return 0
+    category = unicodedata.category(chr(code))
+    if category in ('Mn', 'Me', 'Cf', 'Cc', 'Cs'):
+        return 0
+    if unicodedata.east_asian_width(chr(code)) in ('W', 'F'):
+        return 2
+    # unassigned codepoints in the wide planes are reserved for wide ones
+    if category == 'Cn' and (0x20000 <= code <= 0x2FFFD or 0x30000 <= code <= 0x3FFFD):
+        return 2
+    return 1
+
+
+def main():
+    blocks = []
+    index = {}
+    stage1 = []
+    for start in range(0, 0x110000, BLOCK):
+        packed = bytearray(BLOCK // 4)
+        for i in range(BLOCK):
+            packed[i // 4] |= width(start + i) << ((i % 4) * 2)
+        packed = bytes(packed)
+        if packed not in index:
+            index[packed] = len(blocks)
+            blocks.append(packed)
+        stage1.append(index[packed])
+
+    assert len(blocks) <= 256
+
+    out = sys.stdout
+    out.write('// Generated by tools/gen_charwidth.py from Unicode %s, do not edit.\n\n'
+              % unicodedata.unidata_version)
+    out.write('#ifndef CHARWIDTHTABLE_H\n#define CHARWIDTHTABLE_H\n\n')
+    out.write('// block of each 256 codepoints\n')
+    out.write('static const quint8 charWidthStage1[%d] = {\n' % len(stage1))
+    for i in range(0, len(stage1), 16):
+        out.write('    ' + ', '.join('%3d' % b for b in stage1[i:i+16]) + ',\n')
+    out.write('};\n\n')
+    out.write('// widths of the codepoints of a block, two bits each, lowest first\n')
+    out.write('static const quint8 charWidthStage2[%d][%d] = {\n' % (len(blocks), BLOCK // 4))
+    for block in blocks:
+        out.write('    {\n')
+        for i in range(0, len(block), 16):
+            out.write('        ' + ', '.join('0x%02x' % b for b in block[i:i+16]) + ',\n')
+        out.write('    },\n')
+    out.write('};\n\n#endif // CHARWIDTHTABLE_H\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,10 @@
+TEMPLATE = app
+TARGET = toeterm-latency
+CONFIG += console c++11
+CONFIG -= app_bundle
+QT = core
+LIBS += -lutil
+
+include(../../core/core.pri)
+
+SOURCES += main.cpp
@@ -0,0 +1,94 @@
+/*
+    ThumbTerm Copyright Olli Vanhoja
+    FingerTerm Copyright 2011-2012 Heikki Holstila <heikki.holstila@gmail.com>
+    ToeTerm Copyright 2018 ROZZ, 2019 Matti Viljanen
+
+    This file is part of ToeTerm.
+
+    ToeTerm is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    ToeTerm is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ToeTerm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QCoreApplication>
+#include <QTextStream>
+#include <QTimer>
+
+extern "C" {
+#include <pty.h>
+#include <stdlib.h>
+#include <unistd.h>
+}
+
+#include "terminal.h"
+#include "ptyiface.h"
+
+// Types into a local echo process through a real pty and prints the key
+// press latencies, for numbers that do not depend on the shell or the
+// device. There is no renderer, so the frame is taken to be painted when
+// the terminal has parsed the echo and reports the display changed.
+int main(int argc, char *argv[])
+{
+    QString command = "stty raw -echo; exec cat";
+    int keys = 500;
+    int interval = 20;
+    for(int i=1; i<argc-1; i++) {
+        const QString arg(argv[i]);
+        if(arg == "-e")
+            command = QString(argv[i+1]);
+        else if(arg == "--keys")
+            keys = QString(argv[i+1]).toInt();
+        else if(arg == "--interval")
+            interval = QString(argv[i+1]).toInt();
+    }
+
+    // fork the child process before creating QCoreApplication
+    int socketM;
+    int pid = forkpty(&socketM,NULL,NULL,NULL);
+    if( pid==-1 ) {
+        qFatal("forkpty failed");
+    } else if( pid==0 ) {
+        execl("/bin/sh", "sh", "-c", command.toLocal8Bit().constData(), (char*)0);
+        exit(1);
+    }
+
+    QCoreApplication app(argc, argv);
+
+    Terminal term;
+    term.setTermSize(QSize(80, 24));
+    term.latency().setEnabled(true);
+    QObject::connect(&term, &Terminal::displayBufferChanged, [&term]() { term.latency().painted(); });
+
+    PtyIFace ptyiface(pid, socketM, &term, "UTF-8");
+    if( ptyiface.failed() )
+        qFatal("pty failure");
+
+    int typed = 0;
+    QTimer typer;
+    typer.setInterval(interval);
+    QObject::connect(&typer, &QTimer::timeout, [&]() {
+        if(typed == keys) {
+            typer.stop();
+            QTimer::singleShot(500, &app, SLOT(quit()));  // the last echoes
+            return;
+        }
+        term.keyPress('a' + typed % 26, 0);
+        typed++;
+    });
+    // give the child time to set up the tty
+    QTimer::singleShot(200, &typer, SLOT(start()));
+
+    app.exec();
+
+    QTextStream(stdout) << term.latency().report() << endl;
+    return 0;
+}
@@ -0,0 +1,227 @@
+/*
+    ThumbTerm Copyright Olli Vanhoja
+    FingerTerm Copyright 2011-2012 Heikki Holstila <heikki.holstila@gmail.com>
+    ToeTerm Copyright 2018 ROZZ, 2019 Matti Viljanen
+
+    This file is part of ToeTerm.
+
+    ToeTerm is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    ToeTerm is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ToeTerm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPainter>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#include "terminal.h"
+#include "textrender.h"
+
+// Frame times of TextRender::paint() into an offscreen image, for a set of
+// canned screens and font sizes, as JSON. Runs on the offscreen platform
+// plugin, so no display or GPU is needed.
+
+static const QChar ESC(0x1B);
+
+class BenchSettings : public TermSettings
+{
+public:
+    explicit BenchSettings(const QString& path) : iPath(path) {}
+    QVariant settingsValue(QString key) { return iValues.value(key); }
+    void setSettingsValue(QString key, QVariant value) { iValues.insert(key, value); }
+    QString configPath() { return iPath; }
+private:
+    QString iPath;
+    QHash<QString, QVariant> iValues;
+};
+
+static QString plainScreen(QSize size)
+{
+    QString out;
+    for(int row=0; row<size.height(); row++) {
+        QString line;
+        while(line.size() < size.width())
+            line += "lorem ipsum dolor sit amet ";
+        out += line.left(size.width()-1) + "\r\n";
+    }
+    return out;
+}
+
+static QString colorScreen(QSize size)
+{
+    // every cell gets its own foreground and background
+    QString out;
+    int color = 0;
+    for(int row=0; row<size.height(); row++) {
+        for(int col=0; col<size.width()-1; col++, color++)
+            out += QString("%1[38;5;%2;48;5;%3m%4").arg(ESC).arg(color % 256).arg((color * 7 + 128) % 256)
+                    .arg(QChar('a' + col % 26));
+        out += QString("%1[0m\r\n").arg(ESC);
+    }
+    return out;
+}
+
+static QString boldScreen(QSize size)
+{
+    QString out;
+    for(int row=0; row<size.height(); row++) {
+        for(int col=0; col<size.width()-1; col++)
+            out += QString("%1[%2m%3").arg(ESC).arg(col % 2 ? 1 : 22).arg(QChar('a' + col % 26));
+        out += QString("%1[0m\r\n").arg(ESC);
+    }
+    return out;
+}
+
+static QString wideScreen(QSize size)
+{
+    // double width CJK, mostly from fallback fonts
+    static const ushort cjk[] = { 0x4E2D, 0x6587, 0x65E5, 0x672C, 0x8A9E, 0xD55C, 0xAD6D };
+    QString out;
+    for(int row=0; row<size.height(); row++) {
+        for(int col=0; col<size.width()/2-1; col++)
+            out += QChar(cjk[(row + col) % 7]);
+        out += "\r\n";
+    }
+    return out;
+}
+
+static QString scrolledScreen(QSize size)
+{
+    // shown scrolled back, with half of the view from the back buffer
+    QString out;
+    for(int line=0; line<size.height()*10; line++)
+        out += QString("%1[3%2mline %3 ").arg(ESC).arg(line % 8).arg(line) + plainScreen(QSize(size.width()-12, 1));
+    return out;
+}
+
+struct Case {
+    QString name;
+    QString (*screen)(QSize);
+    bool scrolled;
+};
+
+static double percentile(const QVector<qint64>& sorted, double p)
+{
+    return sorted.at(qMin(sorted.size()-1, int(p * sorted.size()))) / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    if(qgetenv("QT_QPA_PLATFORM").isEmpty())
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    // TextRender keeps its color schemes under $HOME; keep the run from
+    // touching the real ones
+    QTemporaryDir home;
+    qputenv("HOME", home.path().toLocal8Bit());
+
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures TextRender frame times into an offscreen image.");
+    parser.addHelpOption();
+    QCommandLineOption sizeOption("size", "Image size in pixels.", "WxH", "540x960");
+    QCommandLineOption fontOption("font", "Font family.", "family", "monospace");
+    QCommandLineOption fontSizesOption("font-sizes", "Comma separated point sizes.", "sizes", "8,11,16,24");
+    QCommandLineOption framesOption("frames", "Measured frames per case.", "n", "200");
+    QCommandLineOption onlyOption("only", "Run only the named case.", "name");
+    parser.addOption(sizeOption);
+    parser.addOption(fontOption);
+    parser.addOption(fontSizesOption);
+    parser.addOption(framesOption);
+    parser.addOption(onlyOption);
+    parser.process(app);
+
+    const QStringList dims = parser.value(sizeOption).split('x');
+    const QSize imageSize = dims.count() == 2 ? QSize(dims.at(0).toInt(), dims.at(1).toInt()) : QSize();
+    if(imageSize.isEmpty())
+        parser.showHelp(2);
+    const int frames = qMax(1, parser.value(framesOption).toInt());
+
+    BenchSettings settings(home.path());
+    settings.setSettingsValue("ui/fontFamily", parser.value(fontOption));
+    settings.setSettingsValue("ui/fontSize", 11);
+
+    QList<Case> cases;
+    cases << Case{ "plain", plainScreen, false }
+          << Case{ "colors", colorScreen, false }
+          << Case{ "bold", boldScreen, false }
+          << Case{ "wide", wideScreen, false }
+          << Case{ "scrolled", scrolledScreen, true };
+
+    QJsonArray results;
+    foreach(const QString& fontSize, parser.value(fontSizesOption).split(',')) {
+        foreach(const Case& c, cases) {
+            if(parser.isSet(onlyOption) && parser.value(onlyOption) != c.name)
+                continue;
+
+            Terminal term;
+            TextRender render;
+            render.setSettings(&settings);
+            render.loadColorScheme("default");
+            render.setMyWidth(imageSize.width());
+            render.setMyHeight(imageSize.height());
+            render.setTerminal(&term);
+            render.setFontPointSize(fontSize.toInt());
+            render.updateTermSize();
+
+            term.insertInBuffer(c.screen(term.termSize()));
+            if(c.scrolled)
+                term.scrollBackBufferBack(term.termSize().height() / 2);
+
+            QImage image(imageSize, QImage::Format_ARGB32_Premultiplied);
+            QVector<qint64> times;
+            times.reserve(frames);
+            for(int i=0; i<=frames; i++) {  // the first frame warms up the caches
+                QElapsedTimer timer;
+                timer.start();
+                image.fill(Qt::black);
+                QPainter painter(&image);
+                render.paint(&painter);
+                painter.end();
+                if(i > 0)
+                    times.append(timer.nsecsElapsed());
+            }
+            std::sort(times.begin(), times.end());
+
+            QJsonObject result;
+            result.insert("name", c.name);
+            result.insert("fontSize", fontSize.toInt());
+            result.insert("termSize", QString("%1x%2").arg(term.termSize().width()).arg(term.termSize().height()));
+            result.insert("p50Ms", percentile(times, 0.50));
+            result.insert("p90Ms", percentile(times, 0.90));
+            result.insert("p99Ms", percentile(times, 0.99));
+            result.insert("maxMs", times.last() / 1e6);
+            result.insert("drawCalls", render.paintDrawCalls());
+            result.insert("allocations", render.paintAllocations());
+            results.append(result);
+        }
+    }
+
+    QJsonObject report;
+    report.insert("size", parser.value(sizeOption));
+    report.insert("font", parser.value(fontOption));
+    report.insert("frames", frames);
+    report.insert("cases", results);
+    QTextStream(stdout) << QJsonDocument(report).toJson();
+    return 0;
+}
@@ -0,0 +1,19 @@
+TEMPLATE = app
+TARGET = toeterm-renderbench
+CONFIG += console c++11
+CONFIG -= app_bundle
+QT = core gui quick
+
+include(../../core/core.pri)
+
+# the renderer is built from the app sources; it only needs TermSettings
+HEADERS += \
+    $$top_srcdir/src/textrender.h \
+    $$top_srcdir/src/glyphcache.h \
+    $$top_srcdir/src/fontfallback.h
+
+SOURCES += \
+    main.cpp \
+    $$top_srcdir/src/textrender.cpp \
+    $$top_srcdir/src/glyphcache.cpp \
+    $$top_srcdir/src/fontfallback.cpp
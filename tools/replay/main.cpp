@@ -0,0 +1,55 @@
+/*
+    ThumbTerm Copyright Olli Vanhoja
+    FingerTerm Copyright 2011-2012 Heikki Holstila <heikki.holstila@gmail.com>
+    ToeTerm Copyright 2018 ROZZ, 2019 Matti Viljanen
+
+    This file is part of ToeTerm.
+
+    ToeTerm is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    ToeTerm is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ToeTerm.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QCoreApplication>
+#include <QTextStream>
+
+#include "terminal.h"
+#include "replay.h"
+
+// Feeds a session recorded with toeterm --record to the emulator core and
+// prints how fast it was parsed and a hash of the final screen.
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QString file;
+    bool realtime = false;
+    foreach(const QString& arg, app.arguments().mid(1)) {
+        if(arg == "--realtime")
+            realtime = true;
+        else
+            file = arg;
+    }
+    if(file.isEmpty()) {
+        QTextStream(stderr) << "usage: toeterm-replay [--realtime] <recording.cast>" << endl
+                            << "A recording started before the window had a size replays at 80x24" << endl
+                            << "until its first resize event." << endl;
+        return 2;
+    }
+
+    Terminal term;
+    Replay replay(&term);
+    if(!replay.run(file, realtime))
+        return 1;
+    replay.printReport();
+    return 0;
+}
@@ -0,0 +1,9 @@
+TEMPLATE = app
+TARGET = toeterm-replay
+CONFIG += console c++11
+CONFIG -= app_bundle
+QT = core
+
+include(../../core/core.pri)
+
+SOURCES += main.cpp